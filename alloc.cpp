@@ -0,0 +1,49 @@
+#include <new>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+
+
+// counts per thread so that it does not need to be atomic
+static thread_local uint64_t n_allocations = 0;
+
+uint64_t getAllocationCount()
+{
+	return n_allocations;
+}
+
+void *operator new(size_t size)
+{
+	n_allocations++;
+
+	if (void *p = malloc(size ? size : 1))
+		return p;
+
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+	free(p);
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+
+
+// number of heap allocations (operator new) done by the calling thread
+// only in a build with -DCOUNT_ALLOCS=ON: it replaces operator new for that
+uint64_t getAllocationCount();
@@ -0,0 +1,581 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "alphabeta.h"
+#include "board.h"
+#include "helpers.h"
+#include "io.h"
+#include "score.h"
+#include "tt.h"
+
+
+constexpr int AB_INF = 32767;
+
+// nodes with less depth left than this are always searched by one thread
+constexpr int YBWC_MIN_SPLIT_DEPTH = 2;
+
+constexpr point_t NO_KILLER = 0xffff;
+
+// half the width of the first aspiration window, in points
+constexpr int ASPIRATION_DELTA = 2;
+
+#ifdef CALC_BCO
+static std::atomic<double>   bco_total { 0 };
+static std::atomic_uint64_t  bco_n     { 0 };
+
+double getBCO()
+{
+	return bco_total / bco_n;
+}
+
+uint64_t getBCOn()
+{
+	return bco_n;
+}
+#endif
+
+// a node of which the remaining moves are searched by more than one thread
+typedef struct split_point {
+	std::mutex                lock;
+	std::vector<point_t>      path;       // moves from the root to this node
+	player_t                  p;
+	int                       depth;
+	int                       beta;
+	std::atomic_int           alpha;
+	int                       bestScore;  // "lock"
+	std::optional<point_t>    bestMove;   // "lock"
+	const move_list_t        *moves;
+	std::atomic_int           next;       // index in "moves" of the next one to hand out
+	std::atomic_int           workers;    // threads (the owner included) busy with it
+	std::atomic_bool          cutoff;
+	const struct split_point *parent;
+} split_point_t;
+
+// shared by the threads of one searchParallel()
+typedef struct {
+	std::mutex                   lock;
+	// signalled when a split point is opened, when the last worker of a
+	// split point leaves it and when the search is done
+	std::condition_variable      cv;
+	std::vector<split_point_t *> open;  // split points that may have moves left ("lock")
+	std::atomic_int              idle;  // threads waiting for a split point
+	bool                         done;  // "lock"
+	player_t                     rootPlayer;
+} ybwc_t;
+
+typedef struct {
+	Board                *b;
+	std::vector<point_t>  path;    // moves from the root to the current node
+	ybwc_t               *shared;  // nullptr when searching on one thread
+	const Deadline       *stop;
+	double                komi;
+	TranspositionTable   *tt;      // nullptr: none
+	ordering_t           *ordering;  // nullptr: none
+	uint64_t              nodes;
+} thread_state_t;
+
+void orderingClear(ordering_t *const o)
+{
+	for(int p=0; p<2; p++) {
+		for(auto & h : o->history[p])
+			h.store(0, std::memory_order_relaxed);
+	}
+
+	for(auto & k : o->killers) {
+		k[0].store(NO_KILLER, std::memory_order_relaxed);
+		k[1].store(NO_KILLER, std::memory_order_relaxed);
+	}
+}
+
+// "move" gave a beta cut-off at "ply"
+static void updateOrdering(thread_state_t *const ts, const player_t p, const point_t move, const int depth, const int ply)
+{
+	if (ts->ordering == nullptr)
+		return;
+
+	ts->ordering->history[p][move].fetch_add(uint64_t(depth) * depth, std::memory_order_relaxed);
+
+	auto & killers = ts->ordering->killers[ply];
+
+	if (killers[0].load(std::memory_order_relaxed) != move) {
+		killers[1].store(killers[0].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		killers[0].store(move, std::memory_order_relaxed);
+	}
+}
+
+// the move from the transposition table first; then (not at the root, those
+// are in the order of the caller) the killers and the rest by history
+static void orderMoves(const thread_state_t *const ts, const player_t p, move_list_t *const moves, const std::optional<point_t> & ttMove, const bool isRoot)
+{
+	int first = 0;
+
+	if (ttMove.has_value()) {
+		for(int i=0; i<moves->n; i++) {
+			if (moves->moves[i] == ttMove.value()) {
+				std::rotate(&moves->moves[0], &moves->moves[i], &moves->moves[i + 1]);
+				first = 1;
+				break;
+			}
+		}
+	}
+
+	if (isRoot || ts->ordering == nullptr)
+		return;
+
+	const int     ply = ts->path.size();
+	const point_t k0  = ts->ordering->killers[ply][0].load(std::memory_order_relaxed);
+	const point_t k1  = ts->ordering->killers[ply][1].load(std::memory_order_relaxed);
+
+	// key (upper 48 bits) and move (lower 16) in one word: one cheap sort and
+	// a snapshot of the history that other threads keep updating
+	constexpr uint64_t max_history = (uint64_t(1) << 46) - 1;
+
+	uint64_t keyed[MAX_DIM * MAX_DIM];
+
+	for(int i=first; i<moves->n; i++) {
+		const point_t move = moves->moves[i];
+
+		uint64_t key = 0;
+
+		if (move == k0)
+			key = max_history + 2;
+		else if (move == k1)
+			key = max_history + 1;
+		else
+			key = std::min(ts->ordering->history[p][move].load(std::memory_order_relaxed), max_history);
+
+		keyed[i] = (key << 16) | move;
+	}
+
+	std::sort(&keyed[first], &keyed[moves->n], std::greater<uint64_t>());
+
+	for(int i=first; i<moves->n; i++)
+		moves->moves[i] = point_t(keyed[i]);
+}
+
+static int evaluate(const Board & b, const player_t p, const double komi)
+{
+	auto s = score(b, komi);
+
+	return p == P_BLACK ? s.first - s.second : s.second - s.first;
+}
+
+// a beta cut-off in a split point makes everything below it useless
+static bool isCutoff(const split_point_t *sp)
+{
+	for(; sp; sp = sp->parent) {
+		if (sp->cutoff.load(std::memory_order_relaxed))
+			return true;
+	}
+
+	return false;
+}
+
+static int searchNode(thread_state_t *const ts, const player_t p, int alpha, const int beta, const int depth, const split_point_t *const sp, const move_list_t *const given, std::optional<point_t> *const bestMoveOut);
+
+// searches the moves of "s" that are not taken yet; by the owner and by helpers
+static void searchSplitPoint(thread_state_t *const ts, split_point_t *const s)
+{
+	const player_t opponent = getOpponent(s->p);
+
+	for(;;) {
+		if (s->cutoff || isCutoff(s->parent) || ts->stop->isStopped())
+			break;
+
+		const int i = s->next.fetch_add(1);
+
+		if (i >= s->moves->n)
+			break;
+
+		const point_t move = s->moves->moves[i];
+
+		play(ts->b, move, s->p);
+		ts->path.push_back(move);
+
+		// the alpha as raised by any of the threads so far
+		const int alpha = s->alpha.load();
+
+		// never the first move of a node: null window first (PVS)
+		int score = -searchNode(ts, opponent, -alpha - 1, -alpha, s->depth - 1, s, nullptr, nullptr);
+
+		if (score > alpha && score < s->beta)
+			score = -searchNode(ts, opponent, -s->beta, -alpha, s->depth - 1, s, nullptr, nullptr);
+
+		ts->path.pop_back();
+		ts->b->unplay();
+
+		// an aborted subtree has no valid score
+		if (ts->stop->isStopped() || isCutoff(s))
+			break;
+
+		std::unique_lock<std::mutex> lck(s->lock);
+
+		if (score > s->bestScore) {
+			s->bestScore = score;
+			s->bestMove  = move;
+
+			if (score > s->alpha) {
+				s->alpha = score;
+
+				if (score >= s->beta) {
+					s->cutoff = true;
+
+					updateOrdering(ts, s->p, move, s->depth, s->path.size());
+				}
+			}
+		}
+	}
+
+	// the owner may be waiting for the last one
+	if (s->workers.fetch_sub(1) == 1) {
+		std::unique_lock<std::mutex> lck(ts->shared->lock);
+
+		ts->shared->cv.notify_all();
+	}
+}
+
+static bool isBelow(const split_point_t *sp, const split_point_t *const ancestor)
+{
+	for(sp = sp->parent; sp; sp = sp->parent) {
+		if (sp == ancestor)
+			return true;
+	}
+
+	return false;
+}
+
+// a split point with moves left, below "ancestor" if not nullptr; with "lock" of "shared" held
+static split_point_t *findSplitPoint(ybwc_t *const shared, const split_point_t *const ancestor)
+{
+	// the oldest split point has the biggest subtrees left
+	for(auto candidate : shared->open) {
+		if (candidate->next < candidate->moves->n && candidate->cutoff == false && (ancestor == nullptr || isBelow(candidate, ancestor))) {
+			candidate->workers++;
+
+			return candidate;
+		}
+	}
+
+	return nullptr;
+}
+
+// from a position on the path to "s" (the root for a helper, a split point
+// above "s" for its owner) to "s", search its moves and go back
+static void helpAt(thread_state_t *const ts, split_point_t *const s)
+{
+	const size_t base = ts->path.size();
+
+	for(size_t i=base; i<s->path.size(); i++) {
+		play(ts->b, s->path[i], i & 1 ? getOpponent(ts->shared->rootPlayer) : ts->shared->rootPlayer);
+
+		ts->path.push_back(s->path[i]);
+	}
+
+	searchSplitPoint(ts, s);
+
+	while(ts->path.size() > base) {
+		ts->path.pop_back();
+		ts->b->unplay();
+	}
+}
+
+// the moves "first"... of "moves" are made available to idle threads
+static int split(thread_state_t *const ts, const player_t p, const int alpha, const int beta, const int depth, const move_list_t & moves, const int first, const int bestScore, std::optional<point_t> *const bestMove, const split_point_t *const parent)
+{
+	split_point_t s;
+	s.path      = ts->path;
+	s.p         = p;
+	s.depth     = depth;
+	s.beta      = beta;
+	s.alpha     = alpha;
+	s.bestScore = bestScore;
+	s.bestMove  = *bestMove;
+	s.moves     = &moves;
+	s.next      = first;
+	s.workers   = 1;
+	s.cutoff    = false;
+	s.parent    = parent;
+
+	ybwc_t *const shared = ts->shared;
+
+	{
+		std::unique_lock<std::mutex> lck(shared->lock);
+		shared->open.push_back(&s);
+
+		shared->cv.notify_all();
+	}
+
+	searchSplitPoint(ts, &s);
+
+	{
+		std::unique_lock<std::mutex> lck(shared->lock);
+		shared->open.erase(std::find(shared->open.begin(), shared->open.end(), &s));
+	}
+
+	// no one can join anymore: until the helpers finished their move, help
+	// them at the split points they made (helpful master)
+	shared->idle++;
+
+	std::unique_lock<std::mutex> lck(shared->lock);
+
+	while(s.workers > 0) {
+		split_point_t *below = findSplitPoint(shared, &s);
+
+		if (below == nullptr) {
+			shared->cv.wait(lck);
+			continue;
+		}
+
+		lck.unlock();
+
+		shared->idle--;
+
+		helpAt(ts, below);
+
+		shared->idle++;
+
+		lck.lock();
+	}
+
+	lck.unlock();
+
+	shared->idle--;
+
+	*bestMove = s.bestMove;
+
+	return s.bestScore;
+}
+
+// "given": the moves to search (for the root), nullptr to generate them
+static int searchNode(thread_state_t *const ts, const player_t p, int alpha, const int beta, const int depth, const split_point_t *const sp, const move_list_t *const given, std::optional<point_t> *const bestMoveOut)
+{
+	if (ts->stop->isStopped() || isCutoff(sp))
+		return -AB_INF;
+
+	ts->nodes++;
+
+	if (depth == 0)
+		return evaluate(*ts->b, p, ts->komi);
+
+	const int alphaOrig = alpha;
+
+	std::optional<tt_entry_t> hint;
+
+	if (ts->tt) {
+		hint = ts->tt->lookup(ts->b->getKey());
+
+		// at the root a move is required
+		if (hint.has_value() && hint.value().depth >= depth && given == nullptr) {
+			const int ttScore = hint.value().score;
+
+			if (hint.value().bound == TT_EXACT ||
+				(hint.value().bound == TT_LOWER && ttScore >= beta) ||
+				(hint.value().bound == TT_UPPER && ttScore <= alpha))
+				return ttScore;
+		}
+	}
+
+	move_list_t moves;
+
+	if (given)
+		moves = *given;
+	else
+		ts->b->generateMoves(playerToStone(p), &moves);
+
+	// no valid moves? return score (eval)
+	if (moves.n == 0)
+		return evaluate(*ts->b, p, ts->komi);
+
+	orderMoves(ts, p, &moves, hint.has_value() ? hint.value().move : std::optional<point_t>(), given != nullptr);
+
+	int bestScore = -AB_INF - 1;
+	std::optional<point_t> bestMove;
+
+	const player_t opponent = getOpponent(p);
+
+#ifdef CALC_BCO
+	int bco = 0;
+#endif
+
+	for(int i=0; i<moves.n; i++) {
+		// young brothers wait: the first move is always searched by this thread
+		if (i > 0 && ts->shared && depth >= YBWC_MIN_SPLIT_DEPTH && ts->shared->idle > 0) {
+			bestScore = split(ts, p, alpha, beta, depth, moves, i, bestScore, &bestMove, sp);
+
+#ifdef CALC_BCO
+			bco = moves.n;
+#endif
+			break;
+		}
+
+#ifdef CALC_BCO
+		bco++;
+#endif
+
+		const point_t stone = moves.moves[i];
+
+		play(ts->b, stone, p);
+		ts->path.push_back(stone);
+
+		int score = 0;
+
+		// principal variation search: only the first move gets the full
+		// window, the others are expected to fail low on a null window
+		if (i == 0)
+			score = -searchNode(ts, opponent, -beta, -alpha, depth - 1, sp, nullptr, nullptr);
+		else {
+			score = -searchNode(ts, opponent, -alpha - 1, -alpha, depth - 1, sp, nullptr, nullptr);
+
+			if (score > alpha && score < beta)
+				score = -searchNode(ts, opponent, -beta, -alpha, depth - 1, sp, nullptr, nullptr);
+		}
+
+		ts->path.pop_back();
+		ts->b->unplay();
+
+		if (score > bestScore) {
+			bestScore = score;
+			bestMove  = stone;
+
+			if (score > alpha) {
+				alpha = score;
+
+				if (score >= beta) {
+					updateOrdering(ts, p, stone, depth, ts->path.size());
+					break;
+				}
+			}
+		}
+	}
+
+#ifdef CALC_BCO
+	bco_total = bco_total + double(bco) / moves.n;
+	bco_n++;
+#endif
+
+	if (ts->tt && ts->stop->isStopped() == false && isCutoff(sp) == false) {
+		const tt_bound_t bound = bestScore <= alphaOrig ? TT_UPPER : (bestScore >= beta ? TT_LOWER : TT_EXACT);
+
+		ts->tt->store(ts->b->getKey(), depth, bestScore, bound, bestMove);
+	}
+
+	if (bestMoveOut)
+		*bestMoveOut = bestMove;
+
+	return bestScore;
+}
+
+int search(Board *const b, const player_t & p, int alpha, const int beta, const int depth, const double komi, const Deadline & stop)
+{
+	thread_state_t ts { b, { }, nullptr, &stop, komi, nullptr, nullptr, 0 };
+
+	return searchNode(&ts, p, alpha, beta, depth, nullptr, nullptr, nullptr);
+}
+
+// what the threads other than the first do: help out at split points until the search is done
+static void helper(thread_state_t *const ts)
+{
+	ybwc_t *const shared = ts->shared;
+
+	std::unique_lock<std::mutex> lck(shared->lock);
+
+	while(shared->done == false) {
+		split_point_t *s = findSplitPoint(shared, nullptr);
+
+		if (s == nullptr) {
+			shared->cv.wait(lck);
+			continue;
+		}
+
+		lck.unlock();
+
+		shared->idle--;
+
+		helpAt(ts, s);
+
+		shared->idle++;
+
+		lck.lock();
+	}
+}
+
+search_result_t searchParallel(const Board & b, const player_t p, const int alpha, const int beta, const int depth, const double komi, const move_list_t & rootMoves, ThreadPool *const pool, TranspositionTable *const tt, ordering_t *const ordering, const Deadline & stop)
+{
+	ybwc_t shared;
+	shared.idle       = pool->getN() - 1;
+	shared.done       = false;
+	shared.rootPlayer = p;
+
+	std::atomic_uint64_t nodes { 0 };
+
+	search_result_t result { -AB_INF, { }, 0, false };
+
+	pool->run([&](const int nr) {
+			Board work(b);
+
+			thread_state_t ts { &work, { }, &shared, &stop, komi, tt, ordering, 0 };
+
+			if (nr == 0) {
+				result.score = searchNode(&ts, p, alpha, beta, depth, nullptr, &rootMoves, &result.move);
+
+				std::unique_lock<std::mutex> lck(shared.lock);
+
+				shared.done = true;
+
+				shared.cv.notify_all();
+			}
+			else {
+				helper(&ts);
+			}
+
+			nodes += ts.nodes;
+		});
+
+	result.nodes     = nodes;
+	result.completed = stop.isStopped() == false;
+
+	return result;
+}
+
+search_result_t searchAspiration(const Board & b, const player_t p, const int depth, const std::optional<int> & previous, const double komi, const move_list_t & rootMoves, ThreadPool *const pool, TranspositionTable *const tt, ordering_t *const ordering, const Deadline & stop)
+{
+	if (previous.has_value() == false)
+		return searchParallel(b, p, -AB_INF, AB_INF, depth, komi, rootMoves, pool, tt, ordering, stop);
+
+	int delta = ASPIRATION_DELTA;
+	int alpha = std::max(-AB_INF, previous.value() - delta);
+	int beta  = std::min( AB_INF, previous.value() + delta);
+
+	uint64_t nodes = 0;
+
+	for(;;) {
+		auto result = searchParallel(b, p, alpha, beta, depth, komi, rootMoves, pool, tt, ordering, stop);
+
+		nodes += result.nodes;
+		result.nodes = nodes;
+
+		if (result.completed == false)
+			return result;
+
+		delta *= 2;
+
+		// the score is a bound only: widen that side of the window and search again
+		if (result.score <= alpha && alpha > -AB_INF) {
+			send(true, "# aspiration window %d...%d failed low (%d)", alpha, beta, result.score);
+
+			alpha = std::max(-AB_INF, std::min(alpha, result.score) - delta);
+		}
+		else if (result.score >= beta && beta < AB_INF) {
+			send(true, "# aspiration window %d...%d failed high (%d)", alpha, beta, result.score);
+
+			beta = std::min(AB_INF, std::max(beta, result.score) + delta);
+		}
+		else {
+			return result;
+		}
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <stdint.h>
+
+#include "board.h"
+#include "pool.h"
+#include "tt.h"
+
+
+//#define CALC_BCO
+
+#ifdef CALC_BCO
+// beta cut-off statistics: the fraction of the moves of a node that was
+// searched before it was done (lower is better ordering)
+double getBCO();
+uint64_t getBCOn();
+#endif
+
+// what was learned about move ordering, kept between the depths of an
+// iterative deepening search and shared by all threads
+// history: per player and move, how often it gave a beta cut-off (weighted
+// by depth); killers: per ply the last 2 moves that did so
+typedef struct {
+	std::atomic_uint64_t history[2][MAX_DIM * MAX_DIM];
+	std::atomic<point_t> killers[MAX_DIM * MAX_DIM + 1][2];
+} ordering_t;
+
+void orderingClear(ordering_t *const o);
+
+typedef struct {
+	int                    score;
+	std::optional<point_t> move;
+	uint64_t               nodes;
+	bool                   completed;  // false: stopped by the deadline, score & move are not to be trusted
+} search_result_t;
+
+// "b" is returned in the same state as it was passed
+int search(Board *const b, const player_t & p, int alpha, const int beta, const int depth, const double komi, const Deadline & stop);
+
+// search() on all threads of "pool", young brothers wait: once the first
+// (eldest) move of a node has been searched, threads that have nothing to
+// do take its remaining moves; that at any depth
+// "rootMoves" are the moves to consider at the root, in that order (the
+// best move found in "tt" goes first); "tt" and "ordering" may be nullptr
+search_result_t searchParallel(const Board & b, const player_t p, const int alpha, const int beta, const int depth, const double komi, const move_list_t & rootMoves, ThreadPool *const pool, TranspositionTable *const tt, ordering_t *const ordering, const Deadline & stop);
+
+// searchParallel() with a window of a few points around the score of the
+// previous depth ("previous"), widened and searched again when the score
+// falls outside of it; the full window when there's no previous score
+// "nodes" in the result includes the re-searches
+search_result_t searchAspiration(const Board & b, const player_t p, const int depth, const std::optional<int> & previous, const double komi, const move_list_t & rootMoves, ThreadPool *const pool, TranspositionTable *const tt, ordering_t *const ordering, const Deadline & stop);
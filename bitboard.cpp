@@ -0,0 +1,281 @@
+#include <array>
+#include <assert.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BITBOARD_AVX2
+#include <immintrin.h>
+#endif
+
+#include "bitboard.h"
+
+
+static void selectKernels(bitboard_geometry_t *const g);
+
+static bitboard_geometry_t createGeometry(const int dim)
+{
+	bitboard_geometry_t g;
+	memset(&g, 0x00, sizeof g);
+
+	g.dim = dim;
+
+	for(int y=0; y<dim; y++) {
+		for(int x=0; x<dim; x++) {
+			const int v = y * dim + x;
+
+			bitplaneSet(&g.on_board, v);
+
+			if (x > 0)
+				bitplaneSet(&g.not_left, v);
+
+			if (x < dim - 1)
+				bitplaneSet(&g.not_right, v);
+		}
+	}
+
+	selectKernels(&g);
+
+	return g;
+}
+
+const bitboard_geometry_t & getBitboardGeometry(const int dim)
+{
+	static const std::array<bitboard_geometry_t, BITBOARD_MAX_DIM + 1> geometries = [] {
+		std::array<bitboard_geometry_t, BITBOARD_MAX_DIM + 1> out;
+
+		for(int dim=0; dim<=BITBOARD_MAX_DIM; dim++)
+			out[dim] = createGeometry(dim);
+
+		return out;
+	}();
+
+	assert(dim > 0 && dim <= BITBOARD_MAX_DIM);
+
+	return geometries[dim];
+}
+
+// portable versions
+
+// towards higher cross-numbers, 0 < n < 64
+static inline bitplane_t shiftUp(const bitplane_t & in, const int n)
+{
+	bitplane_t out;
+
+	out.w[0] = in.w[0] << n;
+
+	for(int i=1; i<BITBOARD_WORDS; i++)
+		out.w[i] = (in.w[i] << n) | (in.w[i - 1] >> (64 - n));
+
+	return out;
+}
+
+// towards lower cross-numbers, 0 < n < 64
+static inline bitplane_t shiftDown(const bitplane_t & in, const int n)
+{
+	bitplane_t out;
+
+	for(int i=0; i<BITBOARD_WORDS - 1; i++)
+		out.w[i] = (in.w[i] >> n) | (in.w[i + 1] << (64 - n));
+
+	out.w[BITBOARD_WORDS - 1] = in.w[BITBOARD_WORDS - 1] >> n;
+
+	return out;
+}
+
+// DIM is the board size when known at compile time, 0 for any size (g.dim)
+template <int DIM>
+static inline bitplane_t dilateGeneric(const bitplane_t & in, const bitboard_geometry_t & g)
+{
+	const int dim = DIM ? DIM : g.dim;
+
+	const bitplane_t west  = shiftDown(in, 1);
+	const bitplane_t east  = shiftUp  (in, 1);
+	const bitplane_t south = shiftDown(in, dim);
+	const bitplane_t north = shiftUp  (in, dim);
+
+	bitplane_t out;
+
+	for(int i=0; i<BITBOARD_WORDS; i++)
+		out.w[i] = (in.w[i] | (west.w[i] & g.not_right.w[i]) | (east.w[i] & g.not_left.w[i]) | south.w[i] | north.w[i]) & g.on_board.w[i];
+
+	return out;
+}
+
+template <int DIM>
+static bitplane_t dilateGenericKernel(const bitplane_t & in, const bitboard_geometry_t & g)
+{
+	return dilateGeneric<DIM>(in, g);
+}
+
+template <int DIM>
+static bitplane_t floodGeneric(const bitplane_t & seed, const bitplane_t & mask, const bitboard_geometry_t & g)
+{
+	bitplane_t cur = seed;
+
+	for(;;) {
+		bitplane_t next = bitplaneAnd(dilateGeneric<DIM>(cur, g), mask);
+
+		if (memcmp(&next, &cur, sizeof cur) == 0)
+			return cur;
+
+		cur = next;
+	}
+}
+
+#ifdef BITBOARD_AVX2
+// AVX2 versions: a plane is 2 registers, "lo" (words 0...3) and "hi" (4...7)
+
+typedef struct {
+	__m256i lo;
+	__m256i hi;
+} avx2_plane_t;
+
+__attribute__((target("avx2"))) static inline avx2_plane_t shiftUpAVX2(const avx2_plane_t & in, const int n)
+{
+	const __m256i zero   = _mm256_setzero_si256();
+	const __m128i cnt    = _mm_cvtsi32_si128(n);
+	const __m128i cnt_in = _mm_cvtsi32_si128(64 - n);
+
+	// previous word of each word: lo = [0, w0, w1, w2], hi = [w3, w4, w5, w6]
+	__m256i prev_lo = _mm256_blend_epi32(_mm256_permute4x64_epi64(in.lo, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x03);
+	__m256i prev_hi = _mm256_blend_epi32(_mm256_permute4x64_epi64(in.hi, _MM_SHUFFLE(2, 1, 0, 0)), _mm256_permute4x64_epi64(in.lo, _MM_SHUFFLE(3, 3, 3, 3)), 0x03);
+
+	return { _mm256_or_si256(_mm256_sll_epi64(in.lo, cnt), _mm256_srl_epi64(prev_lo, cnt_in)),
+		 _mm256_or_si256(_mm256_sll_epi64(in.hi, cnt), _mm256_srl_epi64(prev_hi, cnt_in)) };
+}
+
+__attribute__((target("avx2"))) static inline avx2_plane_t shiftDownAVX2(const avx2_plane_t & in, const int n)
+{
+	const __m256i zero   = _mm256_setzero_si256();
+	const __m128i cnt    = _mm_cvtsi32_si128(n);
+	const __m128i cnt_in = _mm_cvtsi32_si128(64 - n);
+
+	// next word of each word: lo = [w1, w2, w3, w4], hi = [w5, w6, w7, 0]
+	__m256i next_lo = _mm256_blend_epi32(_mm256_permute4x64_epi64(in.lo, _MM_SHUFFLE(0, 3, 2, 1)), _mm256_permute4x64_epi64(in.hi, _MM_SHUFFLE(0, 0, 0, 0)), 0xc0);
+	__m256i next_hi = _mm256_blend_epi32(_mm256_permute4x64_epi64(in.hi, _MM_SHUFFLE(0, 3, 2, 1)), zero, 0xc0);
+
+	return { _mm256_or_si256(_mm256_srl_epi64(in.lo, cnt), _mm256_sll_epi64(next_lo, cnt_in)),
+		 _mm256_or_si256(_mm256_srl_epi64(in.hi, cnt), _mm256_sll_epi64(next_hi, cnt_in)) };
+}
+
+__attribute__((target("avx2"))) static inline avx2_plane_t loadAVX2(const bitplane_t & p)
+{
+	return { _mm256_load_si256(reinterpret_cast<const __m256i *>(&p.w[0])), _mm256_load_si256(reinterpret_cast<const __m256i *>(&p.w[4])) };
+}
+
+__attribute__((target("avx2"))) static inline void storeAVX2(bitplane_t *const p, const avx2_plane_t & in)
+{
+	_mm256_store_si256(reinterpret_cast<__m256i *>(&p->w[0]), in.lo);
+	_mm256_store_si256(reinterpret_cast<__m256i *>(&p->w[4]), in.hi);
+}
+
+__attribute__((target("avx2"))) static inline avx2_plane_t dilateAVX2(const avx2_plane_t & in, const avx2_plane_t & on_board, const avx2_plane_t & not_left, const avx2_plane_t & not_right, const int dim)
+{
+	const avx2_plane_t west  = shiftDownAVX2(in, 1);
+	const avx2_plane_t east  = shiftUpAVX2  (in, 1);
+	const avx2_plane_t south = shiftDownAVX2(in, dim);
+	const avx2_plane_t north = shiftUpAVX2  (in, dim);
+
+	__m256i lo = _mm256_or_si256(in.lo, _mm256_or_si256(_mm256_and_si256(west.lo, not_right.lo), _mm256_and_si256(east.lo, not_left.lo)));
+	__m256i hi = _mm256_or_si256(in.hi, _mm256_or_si256(_mm256_and_si256(west.hi, not_right.hi), _mm256_and_si256(east.hi, not_left.hi)));
+
+	lo = _mm256_and_si256(_mm256_or_si256(lo, _mm256_or_si256(south.lo, north.lo)), on_board.lo);
+	hi = _mm256_and_si256(_mm256_or_si256(hi, _mm256_or_si256(south.hi, north.hi)), on_board.hi);
+
+	return { lo, hi };
+}
+
+template <int DIM>
+__attribute__((target("avx2"))) static bitplane_t dilateAVX2(const bitplane_t & in, const bitboard_geometry_t & g)
+{
+	bitplane_t out;
+
+	storeAVX2(&out, dilateAVX2(loadAVX2(in), loadAVX2(g.on_board), loadAVX2(g.not_left), loadAVX2(g.not_right), DIM ? DIM : g.dim));
+
+	return out;
+}
+
+template <int DIM>
+__attribute__((target("avx2"))) static bitplane_t floodAVX2(const bitplane_t & seed, const bitplane_t & mask, const bitboard_geometry_t & g)
+{
+	const int          dim       = DIM ? DIM : g.dim;
+
+	const avx2_plane_t on_board  = loadAVX2(g.on_board);
+	const avx2_plane_t not_left  = loadAVX2(g.not_left);
+	const avx2_plane_t not_right = loadAVX2(g.not_right);
+	const avx2_plane_t m         = loadAVX2(mask);
+
+	avx2_plane_t cur = loadAVX2(seed);
+
+	for(;;) {
+		avx2_plane_t next = dilateAVX2(cur, on_board, not_left, not_right, dim);
+
+		next.lo = _mm256_and_si256(next.lo, m.lo);
+		next.hi = _mm256_and_si256(next.hi, m.hi);
+
+		// anything added? (next is a superset of cur)
+		__m256i diff = _mm256_or_si256(_mm256_xor_si256(next.lo, cur.lo), _mm256_xor_si256(next.hi, cur.hi));
+
+		if (_mm256_testz_si256(diff, diff))
+			break;
+
+		cur = next;
+	}
+
+	bitplane_t out;
+	storeAVX2(&out, cur);
+
+	return out;
+}
+#endif
+
+template <int DIM>
+static void selectKernels(bitboard_geometry_t *const g, const bool use_avx2)
+{
+#ifdef BITBOARD_AVX2
+	if (use_avx2) {
+		g->dilate = dilateAVX2<DIM>;
+		g->flood  = floodAVX2<DIM>;
+
+		return;
+	}
+#endif
+
+	g->dilate = dilateGenericKernel<DIM>;
+	g->flood  = floodGeneric<DIM>;
+}
+
+// selected once per board size, depending on what the cpu supports (other
+// than on x86: always the generic 64 bit versions)
+// the common sizes get a version with the size known at compile time
+static void selectKernels(bitboard_geometry_t *const g)
+{
+#ifdef BITBOARD_AVX2
+	static const bool use_avx2 = [] {
+		__builtin_cpu_init();
+
+		return __builtin_cpu_supports("avx2") != 0;
+	}();
+#else
+	constexpr bool use_avx2 = false;
+#endif
+
+	if (g->dim == 9)
+		selectKernels<9>(g, use_avx2);
+	else if (g->dim == 13)
+		selectKernels<13>(g, use_avx2);
+	else if (g->dim == 19)
+		selectKernels<19>(g, use_avx2);
+	else
+		selectKernels<0>(g, use_avx2);
+}
+
+bitplane_t bitplaneDilate(const bitplane_t & in, const bitboard_geometry_t & g)
+{
+	return g.dilate(in, g);
+}
+
+bitplane_t bitplaneFlood(const bitplane_t & seed, const bitplane_t & mask, const bitboard_geometry_t & g)
+{
+	return g.flood(seed, mask, g);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <bit>
+#include <stdint.h>
+
+
+// one bit per cross, bit "v" is the cross y * dim + x (as in Vertex::getV())
+constexpr int BITBOARD_MAX_DIM = 19;
+constexpr int BITBOARD_WORDS   = 8;  // 512 bits: 2 AVX2 registers
+
+typedef struct alignas(32) {
+	uint64_t w[BITBOARD_WORDS];
+} bitplane_t;
+
+typedef struct bitboard_geometry_t {
+	int        dim;
+	bitplane_t on_board;
+	bitplane_t not_left;   // all crosses except the first column
+	bitplane_t not_right;  // all crosses except the last column
+
+	// implementations for this board size, see bitplaneDilate() & bitplaneFlood()
+	bitplane_t (*dilate)(const bitplane_t & in, const bitboard_geometry_t & g);
+	bitplane_t (*flood )(const bitplane_t & seed, const bitplane_t & mask, const bitboard_geometry_t & g);
+} bitboard_geometry_t;
+
+const bitboard_geometry_t & getBitboardGeometry(const int dim);
+
+// the crosses in "in" and their neighbours
+bitplane_t bitplaneDilate(const bitplane_t & in, const bitboard_geometry_t & g);
+// everything in "mask" that is connected to "seed" (which must be inside mask)
+bitplane_t bitplaneFlood(const bitplane_t & seed, const bitplane_t & mask, const bitboard_geometry_t & g);
+
+inline void bitplaneSet(bitplane_t *const p, const int v)
+{
+	p->w[v >> 6] |= uint64_t(1) << (v & 63);
+}
+
+inline void bitplaneClear(bitplane_t *const p, const int v)
+{
+	p->w[v >> 6] &= ~(uint64_t(1) << (v & 63));
+}
+
+inline bool bitplaneTest(const bitplane_t & p, const int v)
+{
+	return (p.w[v >> 6] >> (v & 63)) & 1;
+}
+
+inline bitplane_t bitplaneAnd(const bitplane_t & a, const bitplane_t & b)
+{
+	bitplane_t out;
+
+	for(int i=0; i<BITBOARD_WORDS; i++)
+		out.w[i] = a.w[i] & b.w[i];
+
+	return out;
+}
+
+inline bitplane_t bitplaneOr(const bitplane_t & a, const bitplane_t & b)
+{
+	bitplane_t out;
+
+	for(int i=0; i<BITBOARD_WORDS; i++)
+		out.w[i] = a.w[i] | b.w[i];
+
+	return out;
+}
+
+// a & ~b
+inline bitplane_t bitplaneAndNot(const bitplane_t & a, const bitplane_t & b)
+{
+	bitplane_t out;
+
+	for(int i=0; i<BITBOARD_WORDS; i++)
+		out.w[i] = a.w[i] & ~b.w[i];
+
+	return out;
+}
+
+inline bool bitplaneIsEmpty(const bitplane_t & p)
+{
+	uint64_t any = 0;
+
+	for(int i=0; i<BITBOARD_WORDS; i++)
+		any |= p.w[i];
+
+	return any == 0;
+}
+
+inline int bitplaneCount(const bitplane_t & p)
+{
+	int n = 0;
+
+	for(int i=0; i<BITBOARD_WORDS; i++)
+		n += std::popcount(p.w[i]);
+
+	return n;
+}
+
+// lowest cross in the plane, -1 if empty
+inline int bitplaneFirst(const bitplane_t & p)
+{
+	for(int i=0; i<BITBOARD_WORDS; i++) {
+		if (p.w[i])
+			return i * 64 + std::countr_zero(p.w[i]);
+	}
+
+	return -1;
+}
+
+// invoke "f" for each cross (v) in the plane, in ascending order
+template <typename F>
+inline void bitplaneForEach(const bitplane_t & p, F && f)
+{
+	for(int i=0; i<BITBOARD_WORDS; i++) {
+		uint64_t word = p.w[i];
+
+		while(word) {
+			f(i * 64 + std::countr_zero(word));
+
+			word &= word - 1;
+		}
+	}
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <assert.h>
 #include <string.h>
 
@@ -7,16 +8,38 @@
 #include "io.h"
 
 
+// calls "f" with the board size as template parameter: the size itself for
+// 9x9, 13x13 and 19x19, so that loop bounds and neighbour offsets are
+// compile-time constants there, and 0 (the size is only known at runtime)
+// for the others
+template <typename F>
+static auto selectForDim(const int dim, F && f)
+{
+	if (dim == 9)
+		return f.template operator()<9>();
+
+	if (dim == 13)
+		return f.template operator()<13>();
+
+	if (dim == 19)
+		return f.template operator()<19>();
+
+	return f.template operator()<0>();
+}
+
+template <int DIM>
+static void connectKernel(Board *const b, ChainMap *const cm, std::vector<chain_t *> *const chainsWhite, std::vector<chain_t *> *const chainsBlack, const board_t what, const int x, const int y);
+
 const char *board_t_name(const board_t v)
 {
-	static const char *const board_t_names[] = { ".", "o", "x" };
+	static const char *const board_t_names[] = { ".", "o", "x", "#" };
 
 	return board_t_names[v];
 }
 
 uint64_t Board::getHashForField(const int v)
 {
-	board_t stone = b[v];
+	board_t stone = b[toPadded(v, dim)];
 
 	if (stone == B_EMPTY)
 		return 0;
@@ -24,22 +47,32 @@ uint64_t Board::getHashForField(const int v)
 	return z->get(v, stone == B_BLACK);
 }
 
-Board::Board(Zobrist *const z, const int dim) : z(z), dim(dim), b(new board_t[dim * dim]())
+Board::Board(Zobrist *const z, const int dim) : z(z), dim(dim), pdim(dim + 2), b(new board_t[pdim * pdim]()), hasPlanes(dim <= BITBOARD_MAX_DIM), cm(new ChainMap(dim))
 {
 	assert(dim & 1);
+	assert(dim <= MAX_DIM);
 
 	z->setDim(dim);
+
+	selectKernels();
+	initPadding();
 }
 
 Board::Board(Zobrist *const z, const std::string & str) : z(z)
 {
 	auto slash = str.find('/');
 
-	dim = slash;
-	b = new board_t[dim * dim]();
+	dim       = slash;
+	pdim      = dim + 2;
+	b         = new board_t[pdim * pdim]();
+	hasPlanes = dim <= BITBOARD_MAX_DIM;
+	cm        = new ChainMap(dim);
 
 	z->setDim(dim);
 
+	selectKernels();
+	initPadding();
+
 	int str_o = 0;
 
 	for(int y=dim - 1; y >= 0; y--) {
@@ -49,9 +82,9 @@ Board::Board(Zobrist *const z, const std::string & str) : z(z)
 			int  o = y * dim + x;
 
 			if (c == 'w' || c == 'W')
-				setAt(x, y, B_WHITE), hash ^= z->get(o, false);
+				setAt(o, B_WHITE);
 			else if (c == 'b' || c == 'B')
-				setAt(x, y, B_BLACK), hash ^= z->get(o, true);
+				setAt(o, B_BLACK);
 			else
 				assert(c == '.');
 
@@ -62,48 +95,659 @@ Board::Board(Zobrist *const z, const std::string & str) : z(z)
 	}
 }
 
-Board::Board(const Board & bIn) : z(bIn.z), dim(bIn.getDim()), b(new board_t[dim * dim])
+Board::Board(const Board & bIn) : z(bIn.z), dim(bIn.getDim()), pdim(bIn.pdim), b(new board_t[pdim * pdim]), planeBlack(bIn.planeBlack), planeWhite(bIn.planeWhite), hasPlanes(bIn.hasPlanes), cm(new ChainMap(dim))
 {
 	assert(dim & 1);
 
-	bIn.getTo(b);
+	memcpy(b, bIn.b, pdim * pdim * sizeof(*b));
+
+	memcpy(offsets, bIn.offsets, sizeof offsets);
+
+	isLegalImpl       = bIn.isLegalImpl;
+	generateMovesImpl = bIn.generateMovesImpl;
+	playImpl          = bIn.playImpl;
+
+	hash    = bIn.hash;
+	nStones = bIn.nStones;
+
+	toMove       = bIn.toMove;
+	koPoint      = bIn.koPoint;
+	passes       = bIn.passes;
+	stateHash    = bIn.stateHash;
+
+	history      = bIn.history;
+	historyIndex = bIn.historyIndex;
+	memcpy(historyStones, bIn.historyStones, sizeof historyStones);
 
-	hash = bIn.hash;
+	copyChains(bIn);
+}
+
+void Board::assign(const Board & bIn)
+{
+	assert(dim == bIn.dim);
+
+	memcpy(b, bIn.b, pdim * pdim * sizeof(*b));
+
+	planeBlack   = bIn.planeBlack;
+	planeWhite   = bIn.planeWhite;
+
+	hash         = bIn.hash;
+	nStones      = bIn.nStones;
+
+	toMove       = bIn.toMove;
+	koPoint      = bIn.koPoint;
+	passes       = bIn.passes;
+	stateHash    = bIn.stateHash;
+
+	// within their capacity, these keep their buffer
+	history      = bIn.history;
+	historyIndex = bIn.historyIndex;
+	memcpy(historyStones, bIn.historyStones, sizeof historyStones);
+
+	nUndos       = 0;
+	captured.clear();
+
+	// back to the (per thread) pool, from where copyChains() takes them again
+	purgeChains(&chainsBlack);
+	purgeChains(&chainsWhite);
+
+	cm->reset();
+
+	chainsValid  = false;
+
+	// else they'd be rebuilt here, for every copy
+	bIn.validateChains();
+
+	copyChains(bIn);
 }
 
 Board::~Board()
 {
+	purgeChains(&chainsBlack);
+	purgeChains(&chainsWhite);
+
+	delete cm;
+
 	delete [] b;
 }
 
+void Board::selectKernels()
+{
+	isLegalImpl       = selectForDim(dim, []<int DIM>() { return &Board::isLegalPadded<DIM>;       });
+	generateMovesImpl = selectForDim(dim, []<int DIM>() { return &Board::generateMovesKernel<DIM>; });
+	playImpl          = selectForDim(dim, []<int DIM>() { return &Board::playKernel<DIM>;          });
+}
+
+void Board::initPadding()
+{
+	// surround the board by an "edge" so that neighbours can be found without bounds checks
+	for(int i=0; i<pdim; i++) {
+		b[i]                     = B_EDGE;  // bottom row
+		b[(pdim - 1) * pdim + i] = B_EDGE;  // top row
+		b[i * pdim]              = B_EDGE;  // left column
+		b[i * pdim + pdim - 1]   = B_EDGE;  // right column
+	}
+
+	offsets[0] = -pdim;
+	offsets[1] = +pdim;
+	offsets[2] = -1;
+	offsets[3] = +1;
+}
+
+void Board::copyChains(const Board & bIn)
+{
+	// not valid? then they'll be rebuilt when required
+	if (bIn.chainsValid == false)
+		return;
+
+	for(auto chain : bIn.chainsWhite) {
+		chain_t *copy = allocChain(chain->type, dim);
+		copy->chain     = chain->chain;
+		copy->liberties = chain->liberties;
+
+		for(auto & stone : copy->chain)
+			cm->setAt(stone, copy);
+
+		chainsWhite.emplace_back(copy);
+	}
+
+	for(auto chain : bIn.chainsBlack) {
+		chain_t *copy = allocChain(chain->type, dim);
+		copy->chain     = chain->chain;
+		copy->liberties = chain->liberties;
+
+		for(auto & stone : copy->chain)
+			cm->setAt(stone, copy);
+
+		chainsBlack.emplace_back(copy);
+	}
+
+	chainsValid = true;
+}
+
+void Board::validateChains() const
+{
+	if (chainsValid)
+		return;
+
+	purgeChains(&chainsBlack);
+	purgeChains(&chainsWhite);
+
+	cm->reset();
+
+	findChains(*this, &chainsWhite, &chainsBlack, cm);
+
+	chainsValid = true;
+}
+
+const ChainMap & Board::getChainMap() const
+{
+	validateChains();
+
+	return *cm;
+}
+
+const std::vector<chain_t *> & Board::getChainsWhite() const
+{
+	validateChains();
+
+	return chainsWhite;
+}
+
+const std::vector<chain_t *> & Board::getChainsBlack() const
+{
+	validateChains();
+
+	return chainsBlack;
+}
+
+void Board::play(const point_t v, const board_t what)
+{
+	(this->*playImpl)(v, what);
+}
+
+template <int DIM>
+void Board::playKernel(const point_t v, const board_t what)
+{
+	const int n    = DIM ? DIM : dim;
+	const int pn   = n + 2;
+	const int offs[4] { -pn, +pn, -1, +1 };
+
+	validateChains();
+
+	// remember what is needed to take this move back
+	if (nUndos == undos.size())
+		undos.emplace_back();
+
+	undo_t & u = undos.at(nUndos++);
+	u.is_pass = false;
+	u.v       = v;
+	u.hash    = hash;
+	u.toMove  = toMove;
+	u.koPoint = koPoint;
+	u.passes  = passes;
+	u.capturedStart = captured.size();
+
+	historyPush(hash);
+
+	const int pv = toPadded(u.v, n);
+
+	chain_t *seen[4] { nullptr };
+	int      nSeen   { 0       };
+
+	for(int i=0; i<4; i++) {
+		auto p = cm->getAtPadded(pv + offs[i]);
+
+		// only liberty is the cross where the stone will be placed? then it'll be captured
+		if (p == nullptr || p->type == what || p->liberties.size() != 1 || std::find(seen, seen + nSeen, p) != seen + nSeen)
+			continue;
+
+		seen[nSeen++] = p;
+
+		captured.insert(captured.end(), p->chain.begin(), p->chain.end());
+	}
+
+	u.nCaptured = captured.size() - u.capturedStart;
+
+	connectKernel<DIM>(this, cm, &chainsWhite, &chainsBlack, what, v % n, v / n);
+
+	// connect() updated the chains of this board
+	chainsValid = true;
+
+	// a single stone that captured a single stone and is in atari itself: ko
+	const chain_t *const c = cm->getAtPadded(pv);
+
+	if (u.nCaptured == 1 && c->chain.size() == 1 && c->liberties.size() == 1)
+		koPoint = captured.back();
+	else
+		koPoint = -1;
+
+	toMove = what == B_BLACK ? B_WHITE : B_BLACK;
+	passes = 0;
+
+	updateStateHash();
+}
+
+void Board::pass()
+{
+	if (nUndos == undos.size())
+		undos.emplace_back();
+
+	undo_t & u = undos.at(nUndos++);
+	u.is_pass = true;
+	u.hash    = hash;
+	u.toMove  = toMove;
+	u.koPoint = koPoint;
+	u.passes  = passes;
+	u.capturedStart = captured.size();
+	u.nCaptured     = 0;
+
+	toMove  = toMove == B_BLACK ? B_WHITE : B_BLACK;
+	koPoint = -1;
+	passes++;
+
+	updateStateHash();
+}
+
+void Board::updateStateHash()
+{
+	stateHash = (toMove == B_WHITE ? z->getSide() : 0) ^ (koPoint != -1 ? z->getKo(koPoint) : 0) ^ z->getPasses(passes);
+}
+
+uint64_t Board::getKey() const
+{
+	return hash ^ stateHash;
+}
+
+board_t Board::getToMove() const
+{
+	return toMove;
+}
+
+int Board::getKoPoint() const
+{
+	return koPoint;
+}
+
+int Board::getPasses() const
+{
+	return passes;
+}
+
+void Board::setState(const board_t toMove, const int passes)
+{
+	this->toMove  = toMove;
+	this->passes  = passes;
+	this->koPoint = -1;
+
+	updateStateHash();
+}
+
+uint64_t Board::getHashAfter(const point_t v, const board_t what) const
+{
+	validateChains();
+
+	uint64_t h  = hash ^ z->get(v, what == B_BLACK);
+
+	const int pv = toPadded(v, dim);
+
+	const chain_t *seen[4] { nullptr };
+	int            nSeen   { 0       };
+
+	for(int i=0; i<4; i++) {
+		auto p = cm->getAtPadded(pv + offsets[i]);
+
+		// will be captured? then its stones go
+		if (p == nullptr || p->type == what || p->liberties.size() != 1 || std::find(seen, seen + nSeen, p) != seen + nSeen)
+			continue;
+
+		seen[nSeen++] = p;
+
+		for(auto stone : p->chain)
+			h ^= z->get(stone, p->type == B_BLACK);
+	}
+
+	return h;
+}
+
+static void historyInsert(std::vector<uint32_t> *const index, const std::vector<uint64_t> & history, const uint32_t nr)
+{
+	const size_t mask = index->size() - 1;
+	size_t       slot = history[nr] & mask;
+
+	while((*index)[slot])
+		slot = (slot + 1) & mask;
+
+	(*index)[slot] = nr + 1;
+}
+
+// "h" is the hash of the current position
+void Board::historyPush(const uint64_t h)
+{
+	history.push_back(h);
+	historyStones[nStones]++;
+
+	// keep the table at most 1/8th full: most lookups (from isLegal()) are misses
+	// and should end at the first slot
+	if (history.size() * 8 > historyIndex.size()) {
+		historyIndex.assign(std::max(size_t(64), historyIndex.size() * 2), 0);
+
+		for(size_t i=0; i<history.size(); i++)
+			historyInsert(&historyIndex, history, i);
+	}
+	else {
+		historyInsert(&historyIndex, history, history.size() - 1);
+	}
+}
+
+void Board::historyPop()
+{
+	// entries are removed in the reverse order of insertion, so no
+	// other entry can be in the probe-sequence behind this one
+	const size_t   mask = historyIndex.size() - 1;
+	const uint32_t nr   = history.size();
+	size_t         slot = history.back() & mask;
+
+	while(historyIndex[slot] != nr)
+		slot = (slot + 1) & mask;
+
+	historyIndex[slot] = 0;
+
+	history.pop_back();
+	historyStones[nStones]--;
+}
+
+bool Board::isInHistory(const uint64_t h) const
+{
+	if (historyIndex.empty())
+		return false;
+
+	const size_t mask = historyIndex.size() - 1;
+
+	for(size_t slot = h & mask; historyIndex[slot]; slot = (slot + 1) & mask) {
+		if (history[historyIndex[slot] - 1] == h)
+			return true;
+	}
+
+	return false;
+}
+
+bool Board::isRepetition() const
+{
+	return isInHistory(hash);
+}
+
+bool Board::wouldRepeat(const point_t v, const board_t what) const
+{
+	return isInHistory(getHashAfter(v, what));
+}
+
+// decided from the liberty counts of the chains around "v" and the hash
+// delta of what it would capture, without playing it
+// "pv" must be empty and the chains valid
+template <int DIM>
+bool Board::isLegalPadded(const int pv, const point_t v, const board_t what) const
+{
+	const int pn = (DIM ? DIM : dim) + 2;
+	const int offs[4] { -pn, +pn, -1, +1 };
+
+	bool hasLiberty = false;
+
+	const chain_t *captured[4] { nullptr };
+	int            nCaptured   { 0       };
+	int            nRemoved    { 0       };
+
+	for(int i=0; i<4; i++) {
+		const int     pc = pv + offs[i];
+		const board_t bv = b[pc];
+
+		if (bv == B_EMPTY) {
+			hasLiberty = true;
+			continue;
+		}
+
+		if (bv == B_EDGE)
+			continue;
+
+		const chain_t *p = cm->getAtPadded(pc);
+
+		if (bv == what) {
+			// connecting to a chain that keeps at least one other liberty
+			if (p->liberties.size() > 1)
+				hasLiberty = true;
+
+			continue;
+		}
+
+		// "v" is its last liberty: captured
+		if (p->liberties.size() != 1 || std::find(captured, captured + nCaptured, p) != captured + nCaptured)
+			continue;
+
+		captured[nCaptured++] = p;
+		nRemoved += p->chain.size();
+
+		hasLiberty = true;
+	}
+
+	// suicide
+	if (hasLiberty == false)
+		return false;
+
+	// (super)ko; only when an earlier position had as many stones
+	if (historyStones[nStones + 1 - nRemoved] == 0)
+		return true;
+
+	uint64_t h = hash ^ z->get(v, what == B_BLACK);
+
+	for(int i=0; i<nCaptured; i++) {
+		for(auto stone : captured[i]->chain)
+			h ^= z->get(stone, captured[i]->type == B_BLACK);
+	}
+
+	return isInHistory(h) == false;
+}
+
+bool Board::isLegal(const point_t v, const board_t what) const
+{
+	validateChains();
+
+	const int pv = toPadded(v, dim);
+
+	return b[pv] == B_EMPTY && (this->*isLegalImpl)(pv, v, what);
+}
+
+void Board::generateMoves(const board_t what, move_list_t *const out) const
+{
+	(this->*generateMovesImpl)(what, out);
+}
+
+template <int DIM>
+void Board::generateMovesKernel(const board_t what, move_list_t *const out) const
+{
+	const int n  = DIM ? DIM : dim;
+	const int pn = n + 2;
+
+	validateChains();
+
+	out->n = 0;
+
+	int o = 0;
+
+	for(int y=1; y<=n; y++) {
+		for(int pv=y * pn + 1, end=pv + n; pv<end; pv++, o++) {
+			if (b[pv] == B_EMPTY && isLegalPadded<DIM>(pv, o, what))
+				out->moves[out->n++] = o;
+		}
+	}
+}
+
+chain_t *Board::rebuildChain(const int pv_start)
+{
+	const board_t type  = b[pv_start];
+
+	chain_t      *chain = allocChain(type, dim);
+
+	int stack[MAX_DIM * MAX_DIM];
+	int sp = 0;
+
+	stack[sp++] = pv_start;
+	cm->setAtPadded(pv_start, chain);
+
+	while(sp) {
+		const int pv = stack[--sp];
+
+		chain->chain.emplace_back(fromPadded(pv, dim));
+
+		for(int i=0; i<4; i++) {
+			const int pn = pv + offsets[i];
+
+			if (b[pn] == B_EMPTY)
+				chain->liberties.insert(fromPadded(pn, dim));
+			else if (b[pn] == type && cm->getAtPadded(pn) == nullptr) {
+				cm->setAtPadded(pn, chain);
+				stack[sp++] = pn;
+			}
+		}
+	}
+
+	if (type == B_WHITE)
+		chainsWhite.emplace_back(chain);
+	else
+		chainsBlack.emplace_back(chain);
+
+	return chain;
+}
+
+void Board::unplay()
+{
+	assert(nUndos > 0);
+
+	const undo_t & u  = undos.at(--nUndos);
+
+	toMove  = u.toMove;
+	koPoint = u.koPoint;
+	passes  = u.passes;
+
+	updateStateHash();
+
+	if (u.is_pass)
+		return;
+
+	assert(chainsValid);
+
+	const int      pv = toPadded(u.v, dim);
+
+	chain_t *const c  = cm->getAtPadded(pv);
+
+	const board_t  what     = c->type;
+	const board_t  opponent = what == B_BLACK ? B_WHITE : B_BLACK;
+
+	const point_t *const capturedBegin = captured.data() + u.capturedStart;
+	const point_t *const capturedEnd   = capturedBegin   + u.nCaptured;
+
+	// put the board back as it was
+	putStone(u.v, pv, B_EMPTY);
+
+	for(auto it = capturedBegin; it != capturedEnd; it++)
+		putStone(*it, toPadded(*it, dim), opponent);
+
+	assert(hash == u.hash);
+
+	historyPop();
+
+	// the chain the stone became part of may have been a merge of several
+	// chains: split it up again by re-tracing from each of its stones
+	auto & chains = what == B_WHITE ? chainsWhite : chainsBlack;
+	chains.erase(std::find(chains.begin(), chains.end(), c));
+
+	for(auto & stone : c->chain)
+		cm->setAt(stone, nullptr);
+
+	for(auto & stone : c->chain) {
+		const int ps = toPadded(stone, dim);
+
+		if (ps != pv && cm->getAtPadded(ps) == nullptr)
+			rebuildChain(ps);
+	}
+
+	freeChain(c);
+
+	// re-create the chains that were captured
+	for(auto it = capturedBegin; it != capturedEnd; it++) {
+		const int ps = toPadded(*it, dim);
+
+		if (cm->getAtPadded(ps) == nullptr)
+			rebuildChain(ps);
+	}
+
+	// liberties of the chains around the affected crosses
+	for(int i=0; i<4; i++) {
+		auto p = cm->getAtPadded(pv + offsets[i]);
+
+		if (p)
+			p->liberties.insert(u.v);
+	}
+
+	for(auto it = capturedBegin; it != capturedEnd; it++) {
+		const int ps = toPadded(*it, dim);
+
+		for(int i=0; i<4; i++) {
+			auto p = cm->getAtPadded(ps + offsets[i]);
+
+			if (p && p->type == what)
+				p->liberties.erase(*it);
+		}
+	}
+
+	captured.resize(u.capturedStart);
+
+	chainsValid = true;
+}
+
 int Board::getDim() const
 {
 	return dim;
 }
 
+int Board::getPaddedDim() const
+{
+	return pdim;
+}
+
+const int *Board::getNeighbourOffsets() const
+{
+	return offsets;
+}
+
 void Board::getTo(board_t *const bto) const
 {
-	memcpy(bto, b, dim * dim * sizeof(*b));
+	for(int v=0; v<dim * dim; v++)
+		bto[v] = b[toPadded(v, dim)];
 }
 
 board_t Board::getAt(const int v) const
 {
 	assert(v < dim * dim);
 	assert(v >= 0);
-	return b[v];
+	return b[toPadded(v, dim)];
 }
 
 board_t Board::getAt(const Vertex & v) const
 {
-	return b[v.getV()];
+	return b[toPadded(v.getV(), dim)];
 }
 
 board_t Board::getAt(const int x, const int y) const
 {
 	assert(x < dim && x >= 0);
 	assert(y < dim && y >= 0);
-	int v = y * dim + x;
-	return b[v];
+	int pv = (y + 1) * pdim + x + 1;
+	return b[pv];
+}
+
+board_t Board::getAtPadded(const int pv) const
+{
+	return b[pv];
 }
 
 uint64_t Board::getHash() const
@@ -111,54 +755,183 @@ uint64_t Board::getHash() const
 	return hash;
 }
 
-void Board::setAt(const int v, const board_t bv)
+void Board::putStone(const int v, const int pv, const board_t bv)
 {
-	assert(v < dim * dim);
-	assert(v >= 0);
-
 	hash ^= getHashForField(v);
 
-	b[v] = bv;
+	if (hasPlanes) {
+		board_t old = b[pv];
+
+		if (old == B_BLACK)
+			bitplaneClear(&planeBlack, v);
+		else if (old == B_WHITE)
+			bitplaneClear(&planeWhite, v);
+
+		if (bv == B_BLACK)
+			bitplaneSet(&planeBlack, v);
+		else if (bv == B_WHITE)
+			bitplaneSet(&planeWhite, v);
+	}
+
+	nStones += (bv != B_EMPTY) - (b[pv] != B_EMPTY);
+
+	b[pv] = bv;
 
 	hash ^= getHashForField(v);
+
+	chainsValid = false;
 }
 
-void Board::setAt(const Vertex & v, const board_t bv)
+void Board::setAt(const int v, const board_t bv)
 {
-	int vd = v.getV();
+	assert(v < dim * dim);
+	assert(v >= 0);
 
-	hash ^= getHashForField(vd);
+	putStone(v, toPadded(v, dim), bv);
+}
 
-	b[vd] = bv;
+void Board::setAt(const Vertex & v, const board_t bv)
+{
+	int vd = v.getV();
 
-	hash ^= getHashForField(vd);
+	putStone(vd, toPadded(vd, dim), bv);
 }
 
 void Board::setAt(const int x, const int y, const board_t bv)
 {
 	assert(x < dim && x >= 0);
 	assert(y < dim && y >= 0);
-	int v = y * dim + x;
 
-	hash ^= getHashForField(v);
-	b[v] = bv;
-	hash ^= getHashForField(v);
+	putStone(y * dim + x, (y + 1) * pdim + x + 1, bv);
+}
+
+bool Board::hasBitplanes() const
+{
+	return hasPlanes;
+}
+
+const bitplane_t & Board::getPlane(const board_t bv) const
+{
+	assert(hasPlanes);
+	assert(bv == B_BLACK || bv == B_WHITE);
+
+	return bv == B_BLACK ? planeBlack : planeWhite;
 }
 
-ChainMap::ChainMap(const int dim) : dim(dim), cm(new chain_t *[dim * dim]()), enclosed(new bool[dim * dim]())
+typedef struct chain_pool_t {
+	std::vector<chain_t *> free;
+
+	~chain_pool_t() {
+		for(auto chain : free)
+			delete chain;
+	}
+} chain_pool_t;
+
+static thread_local chain_pool_t chain_pool;
+
+chain_t *allocChain(const board_t type, const int dim)
+{
+	chain_t *chain = nullptr;
+
+	if (chain_pool.free.empty()) {
+		chain = new chain_t;
+
+		// chains from the pool end up as any other chain: no growing later on
+		chain->chain.reserve(dim * dim);
+	}
+	else {
+		chain = chain_pool.free.back();
+		chain_pool.free.pop_back();
+
+		chain->chain.clear();
+		chain->liberties.clear();
+	}
+
+	chain->type = type;
+	chain->liberties.setDim(dim);
+
+	return chain;
+}
+
+void freeChain(chain_t *const chain)
+{
+	chain_pool.free.emplace_back(chain);
+}
+
+find_liberties_t selectFindLiberties(const int dim);
+
+ChainMap::ChainMap(const int dim) : dim(dim), pdim(dim + 2), cm(new chain_t *[pdim * pdim]()), findLib(selectFindLiberties(dim)), region(new int[pdim * pdim])
 {
 	assert(dim & 1);
+
+	resetRegions();
 }
 
 ChainMap::~ChainMap()
 {
-	delete [] enclosed;
+	delete [] region;
 	delete [] cm;
 }
 
 bool ChainMap::getEnclosed(const int v) const
 {
-	return enclosed[v];
+	const int index = region[toPadded(v, dim)];
+
+	return index >= 0 && regions[index].enclosed;
+}
+
+const region_t * ChainMap::getRegionAt(const int v) const
+{
+	const int index = region[toPadded(v, dim)];
+
+	return index >= 0 ? &regions[index] : nullptr;
+}
+
+int ChainMap::getRegionIndexAtPadded(const int pv) const
+{
+	return region[pv];
+}
+
+void ChainMap::setRegionAtPadded(const int pv, const int index)
+{
+	region[pv] = index;
+}
+
+int ChainMap::getNRegions() const
+{
+	return nRegions;
+}
+
+const region_t & ChainMap::getRegion(const int index) const
+{
+	assert(index >= 0 && index < nRegions);
+
+	return regions[index];
+}
+
+region_t * ChainMap::addRegion(const board_t owner)
+{
+	if (nRegions == int(regions.size()))
+		regions.emplace_back();
+
+	region_t *r = &regions[nRegions++];
+
+	r->owner       = owner;
+	r->nEmpty      = 0;
+	r->nStones     = 0;
+	r->borders.clear();
+	r->touchesEdge = false;
+	r->enclosed    = false;
+
+	return r;
+}
+
+void ChainMap::resetRegions()
+{
+	for(int i=0; i<pdim * pdim; i++)
+		region[i] = -1;
+
+	nRegions = 0;
 }
 
 int ChainMap::getDim() const
@@ -166,40 +939,57 @@ int ChainMap::getDim() const
 	return dim;
 }
 
-chain_t * ChainMap::getAt(const int v) const
+int ChainMap::getPaddedDim() const
+{
+	return pdim;
+}
+
+find_liberties_t ChainMap::getFindLiberties() const
 {
-	return cm[v];
+	return findLib;
 }
 
-chain_t * ChainMap::getAt(const Vertex & v) const
+chain_t * ChainMap::getAt(const int v) const
 {
-	return cm[v.getV()];
+	return cm[toPadded(v, dim)];
 }
 
 chain_t * ChainMap::getAt(const int x, const int y) const
 {
 	assert(x < dim && x >= 0);
 	assert(y < dim && y >= 0);
-	int v = y * dim + x;
-	return cm[v];
+	int pv = (y + 1) * pdim + x + 1;
+	return cm[pv];
 }
 
-void ChainMap::setEnclosed(const int v)
+chain_t * ChainMap::getAtPadded(const int pv) const
 {
-	enclosed[v] = true;
+	return cm[pv];
 }
 
-void ChainMap::setAt(const Vertex & v, chain_t *const chain)
+void ChainMap::reset()
 {
-	setAt(v.getX(), v.getY(), chain);
+	memset(cm, 0x00, pdim * pdim * sizeof(*cm));
+
+	resetRegions();
+}
+
+void ChainMap::setAt(const int v, chain_t *const chain)
+{
+	cm[toPadded(v, dim)] = chain;
 }
 
 void ChainMap::setAt(const int x, const int y, chain_t *const chain)
 {
 	assert(x < dim && x >= 0);
 	assert(y < dim && y >= 0);
-	int v = y * dim + x;
-	cm[v] = chain;
+	int pv = (y + 1) * pdim + x + 1;
+	cm[pv] = chain;
+}
+
+void ChainMap::setAtPadded(const int pv, chain_t *const chain)
+{
+	cm[pv] = chain;
 }
 
 void findChainsScan(std::queue<std::pair<unsigned, unsigned> > *const work_queue, const Board & b, unsigned x, unsigned y, const int dx, const int dy, const board_t type, bool *const scanned)
@@ -227,42 +1017,79 @@ void findChainsScan(std::queue<std::pair<unsigned, unsigned> > *const work_queue
 	}
 }
 
-void pickEmptyAround(const ChainMap & cm, const Vertex & v, std::unordered_set<Vertex, Vertex::HashFunction> *const target)
+void pickEmptyAround(const ChainMap & cm, const point_t v, VertexSet *const target)
 {
-        const int x = v.getX();
-        const int y = v.getY();
         const int dim = cm.getDim();
+        const int x = v % dim;
+        const int y = v / dim;
 
         if (x > 0 && cm.getAt(x - 1, y) == nullptr)
-                target->insert({ x - 1, y, dim });
+                target->insert(v - 1);
 
         if (x < dim - 1 && cm.getAt(x + 1, y) == nullptr)
-                target->insert({ x + 1, y, dim });
+                target->insert(v + 1);
 
         if (y > 0 && cm.getAt(x, y - 1) == nullptr)
-                target->insert({ x, y - 1, dim });
+                target->insert(v - dim);
 
         if (y < dim - 1 && cm.getAt(x, y + 1) == nullptr)
-                target->insert({ x, y + 1, dim });
+                target->insert(v + dim);
 }
 
-void pickEmptyAround(const Board & b, const Vertex & v, std::unordered_set<Vertex, Vertex::HashFunction> *const target)
+void pickEmptyAround(const Board & b, const point_t v, VertexSet *const target)
 {
-	const int x = v.getX();
-	const int y = v.getY();
-	const int dim = b.getDim();
+	const int  dim     = b.getDim();
+	const int  pv      = toPadded(v, dim);
+	const int *offsets = b.getNeighbourOffsets();
+	const int  uoffsets[] { -dim, +dim, -1, +1 };
+
+	for(int i=0; i<4; i++) {
+		if (b.getAtPadded(pv + offsets[i]) == B_EMPTY)
+			target->insert(v + uoffsets[i]);
+	}
+}
+
+// each chain is a flood fill of its first stone in the plane of its color,
+// its liberties are the empty crosses in its dilation
+void findChainsBitplanes(const Board & b, std::vector<chain_t *> *const chainsWhite, std::vector<chain_t *> *const chainsBlack, ChainMap *const cm)
+{
+	const int   dim   = b.getDim();
+	const auto &g     = getBitboardGeometry(dim);
+
+	const bitplane_t empty = bitplaneAndNot(g.on_board, bitplaneOr(b.getPlane(B_BLACK), b.getPlane(B_WHITE)));
+
+	for(board_t type : { B_WHITE, B_BLACK }) {
+		const bitplane_t & stones = b.getPlane(type);
 
-	if (x > 0 && b.getAt(x - 1, y) == B_EMPTY)
-		target->insert({ x - 1, y, dim });
+		auto target = type == B_WHITE ? chainsWhite : chainsBlack;
 
-	if (x < dim - 1 && b.getAt(x + 1, y) == B_EMPTY)
-		target->insert({ x + 1, y, dim });
+		bitplane_t todo = stones;
 
-	if (y > 0 && b.getAt(x, y - 1) == B_EMPTY)
-		target->insert({ x, y - 1, dim });
+		for(;;) {
+			int first = bitplaneFirst(todo);
+			if (first == -1)
+				break;
 
-	if (y < dim - 1 && b.getAt(x, y + 1) == B_EMPTY)
-		target->insert({ x, y + 1, dim });
+			bitplane_t seed { };
+			bitplaneSet(&seed, first);
+
+			bitplane_t chain     = bitplaneFlood(seed, stones, g);
+			bitplane_t liberties = bitplaneAnd(bitplaneDilate(chain, g), empty);
+
+			todo = bitplaneAndNot(todo, chain);
+
+			chain_t *curChain = allocChain(type, dim);
+
+			bitplaneForEach(chain, [&](const int v) {
+					curChain->chain.emplace_back(v);
+					cm->setAtPadded(toPadded(v, dim), curChain);
+				});
+
+			bitplaneForEach(liberties, [&](const int v) { curChain->liberties.insert(v); });
+
+			target->emplace_back(curChain);
+		}
+	}
 }
 
 void findChains(const Board & b, std::vector<chain_t *> *const chainsWhite, std::vector<chain_t *> *const chainsBlack, ChainMap *const cm)
@@ -272,6 +1099,12 @@ void findChains(const Board & b, std::vector<chain_t *> *const chainsWhite, std:
 	assert(chainsWhite->empty());
 	assert(chainsBlack->empty());
 
+	if (b.hasBitplanes()) {
+		findChainsBitplanes(b, chainsWhite, chainsBlack, cm);
+
+		return;
+	}
+
 	bool *scanned = new bool[dim * dim]();
 
 	for(unsigned y=0; y<dim; y++) {
@@ -285,8 +1118,7 @@ void findChains(const Board & b, std::vector<chain_t *> *const chainsWhite, std:
 			if (bv == B_EMPTY)
 				continue;
 
-			chain_t *curChain = new chain_t;
-			curChain->type = bv;
+			chain_t *curChain = allocChain(bv, dim);
 
 			std::queue<std::pair<unsigned, unsigned> > work_queue;
 			work_queue.push({ x, y });
@@ -310,7 +1142,7 @@ void findChains(const Board & b, std::vector<chain_t *> *const chainsWhite, std:
 
 					cm->setAt(x, y, curChain);
 
-					curChain->chain.emplace_back(int(x), int(y), int(dim));
+					curChain->chain.emplace_back(v);
 
 					findChainsScan(&work_queue, b, x, y, 0, -1, cur_bv, scanned);
 					findChainsScan(&work_queue, b, x, y, 0, +1, cur_bv, scanned);
@@ -337,137 +1169,124 @@ void findChains(const Board & b, std::vector<chain_t *> *const chainsWhite, std:
 	delete [] scanned;
 }
 
-void getLiberty(const ChainMap & cm, const int x, const int y, const board_t for_whom, std::unordered_set<Vertex, Vertex::HashFunction> *const targetChain)
+bool checkLiberty(const Board & b, const ChainMap & cm, const int x, const int y, const board_t for_whom)
 {
-	const int dim   = cm.getDim();
-
-	std::vector<Vertex> adjacent = getAdjacentVertexes(x, y, dim);
-
-	for(auto & v: adjacent) {
-		auto c = cm.getAt(v);
-
-		if (c == nullptr)
-			targetChain->insert(v);
-	}
-}
-
-bool checkLiberty(const ChainMap & cm, const int x, const int y, const board_t for_whom)
-{
-	bool      ok    = false;
-	const int dim   = cm.getDim();
-	const int dimm1 = dim - 1;
-
-	std::vector<chain_t *> crosses;
-
-	if (x > 0)
-		crosses.emplace_back(cm.getAt({ x - 1, y, dim }));
+	const int  pv      = (y + 1) * b.getPaddedDim() + x + 1;
+	const int *offsets = b.getNeighbourOffsets();
 
-	if (x < dimm1)
-		crosses.emplace_back(cm.getAt({ x + 1, y, dim }));
+	for(int i=0; i<4; i++) {
+		const int pn = pv + offsets[i];
 
-	if (y > 0)
-		crosses.emplace_back(cm.getAt({ x, y - 1, dim }));
+		if (b.getAtPadded(pn) == B_EDGE)
+			continue;
 
-	if (y < dimm1)
-		crosses.emplace_back(cm.getAt({ x, y + 1, dim }));
+		auto c = cm.getAtPadded(pn);
 
-	for(auto & c: crosses) {
-		if (c == nullptr || (c->type == for_whom && c->liberties.size() > 1) || (c->type != for_whom && c->liberties.size() == 1)) {
-			ok = true;
-			break;
-		}
+		if (c == nullptr || (c->type == for_whom && c->liberties.size() > 1) || (c->type != for_whom && c->liberties.size() == 1))
+			return true;
 	}
 
-	return ok;
+	return false;
 }
 
-void findLiberties(const ChainMap & cm, std::vector<Vertex> *const empties, const board_t for_whom)
+// DIM is the board size when known at compile time, 0 for any size
+template <int DIM>
+static void findLibertiesKernel(const ChainMap & cm, std::vector<point_t> *const empties, const board_t for_whom)
 {
-	const int dim   = cm.getDim();
-	const int dimsq = dim * dim;
-	const int dimm1 = dim - 1;
+	const int dim   = DIM ? DIM : cm.getDim();
+	const int pdim  = dim + 2;
 
-	bool *okFields = new bool[dimsq];
+	// the edge of the padded board stays false
+	bool okFields[(MAX_DIM + 2) * (MAX_DIM + 2)];
+	memset(okFields, 0x00, pdim * pdim * sizeof(bool));
 
-	for(int i=0; i<dimsq; i++) {
-		auto c = cm.getAt(i);
+	for(int y=1; y<=dim; y++) {
+		for(int pv=y * pdim + 1, end=pv + dim; pv<end; pv++) {
+			auto c = cm.getAtPadded(pv);
 
-		okFields[i] = c == nullptr || (c->type == for_whom && c->liberties.size() > 1) || (c->type != for_whom && c->liberties.size() == 1);
+			okFields[pv] = c == nullptr || (c->type == for_whom && c->liberties.size() > 1) || (c->type != for_whom && c->liberties.size() == 1);
+		}
 	}
 
-	empties->reserve(dimsq);
+	empties->reserve(dim * dim);
 
 	int o = 0;
 
-	for(int y=0; y<dim; y++) {
-		for(int x=0; x<dim; x++, o++) {
-			if (cm.getAt(o))
+	for(int y=1; y<=dim; y++) {
+		for(int pv=y * pdim + 1, end=pv + dim; pv<end; pv++, o++) {
+			if (cm.getAtPadded(pv))
 				continue;
 
-			if ((x > 0 && okFields[o - 1]) || (x < dimm1 && okFields[o + 1]) || (y > 0 && okFields[o - dim]) || (y < dimm1 && okFields[o + dim]))
-				empties->emplace_back(o, dim);
+			if (okFields[pv - 1] || okFields[pv + 1] || okFields[pv - pdim] || okFields[pv + pdim])
+				empties->emplace_back(o);
 		}
 	}
-
-	delete [] okFields;
 }
 
-void scanBoundaries(const Board & b, const ChainMap & cm, bool *const scanned, const board_t myStone, const int x, const int y, std::set<chain_t *> *const enclosedBy, bool *const undecided)
+find_liberties_t selectFindLiberties(const int dim)
 {
-	const int dim = b.getDim();
-
-	const int v = y * dim + x;
-
-	board_t stone = b.getAt(x, y);
-
-	if (scanned[v] == false) {
-		scanned[v] = true;
-
-		if (stone == B_EMPTY || stone == myStone) {
-			if (y > 0 && *undecided == false)
-				scanBoundaries(b, cm, scanned, myStone, x, y - 1, enclosedBy, undecided);
-			else
-				*undecided = true;
-			if (y < dim - 1 && *undecided == false)
-				scanBoundaries(b, cm, scanned, myStone, x, y + 1, enclosedBy, undecided);
-			else
-				*undecided = true;
-			if (x > 0 && *undecided == false)
-				scanBoundaries(b, cm, scanned, myStone, x - 1, y, enclosedBy, undecided);
-			else
-				*undecided = true;
-			if (x < dim - 1 && *undecided == false)
-				scanBoundaries(b, cm, scanned, myStone, x + 1, y, enclosedBy, undecided);
-			else
-				*undecided = true;
-		}
-		else {
-			auto chain = cm.getAt(v);
-
-			if (chain->type != myStone)
-				enclosedBy->insert(chain);
-		}
-	}
+	return selectForDim(dim, []<int DIM>() { return findLibertiesKernel<DIM>; });
 }
 
-void scanEnclosed(const Board & b, ChainMap *const cm, const board_t myType)
+void findLiberties(const ChainMap & cm, std::vector<point_t> *const empties, const board_t for_whom)
 {
-	const int dim = cm->getDim();
+	cm.getFindLiberties()(cm, empties, for_whom);
+}
 
-	for(int y=0; y<dim; y++) {
-		for(int x=0; x<dim; x++) {
-			bool *scanned = new bool[dim * dim]();  // TODO: replace by memset
+// splits the board in regions of empty crosses and "myType" stones, in one pass
+// each cross is visited once, using an explicit stack instead of recursion
+// the chains in "cm" must be up to date (findChains())
+void findRegions(const Board & b, ChainMap *const cm, const board_t myType)
+{
+	const int      dim     = b.getDim();
+	const int      pdim    = b.getPaddedDim();
+	const int     *offsets = b.getNeighbourOffsets();
+	const board_t  them    = myType == B_BLACK ? B_WHITE : B_BLACK;
 
-			std::set<chain_t *> enclosedBy;
+	cm->resetRegions();
 
-			bool undecided = false;
+	int stack[MAX_DIM * MAX_DIM];
 
-			scanBoundaries(b, *cm, scanned, myType, x, y, &enclosedBy, &undecided);
+	for(int y=1; y<=dim; y++) {
+		for(int pv=y * pdim + 1, end=pv + dim; pv<end; pv++) {
+			if (b.getAtPadded(pv) == them || cm->getRegionIndexAtPadded(pv) != -1)
+				continue;
 
-			if (!undecided && enclosedBy.size() == 1)
-				cm->setEnclosed(y * dim + x);
+			const int index = cm->getNRegions();
+			region_t *r     = cm->addRegion(myType);
+
+			int sp = 0;
+			stack[sp++] = pv;
+			cm->setRegionAtPadded(pv, index);
+
+			while(sp) {
+				const int cur = stack[--sp];
+
+				if (b.getAtPadded(cur) == B_EMPTY)
+					r->nEmpty++;
+				else
+					r->nStones++;
+
+				for(int i=0; i<4; i++) {
+					const int     pn    = cur + offsets[i];
+					const board_t stone = b.getAtPadded(pn);
+
+					if (stone == B_EDGE)
+						r->touchesEdge = true;
+					else if (stone == them) {
+						chain_t *chain = cm->getAtPadded(pn);
+
+						if (std::find(r->borders.begin(), r->borders.end(), chain) == r->borders.end())
+							r->borders.push_back(chain);
+					}
+					else if (cm->getRegionIndexAtPadded(pn) == -1) {
+						cm->setRegionAtPadded(pn, index);
+						stack[sp++] = pn;
+					}
+				}
+			}
 
-			delete [] scanned;
+			r->enclosed = r->touchesEdge == false && r->borders.size() == 1;
 		}
 	}
 }
@@ -475,121 +1294,114 @@ void scanEnclosed(const Board & b, ChainMap *const cm, const board_t myType)
 void purgeChains(std::vector<chain_t *> *const chains)
 {
 	for(auto chain : *chains)
-		delete chain;
+		freeChain(chain);
 
 	chains->clear();
 }
 
 int countLiberties(const Board & b, const int x, const int y)
 {
-	const int dim = b.getDim();
+	const int  pv      = (y + 1) * b.getPaddedDim() + x + 1;
+	const int *offsets = b.getNeighbourOffsets();
 
 	int n = 0;
 
-	n += x >= 0      && b.getAt(x - 1, y) == B_EMPTY;
-	n += x < dim - 1 && b.getAt(x + 1, y) == B_EMPTY;
-	n += y >= 0      && b.getAt(x, y - 1) == B_EMPTY;
-	n += y < dim - 1 && b.getAt(x, y + 1) == B_EMPTY;
+	for(int i=0; i<4; i++)
+		n += b.getAtPadded(pv + offsets[i]) == B_EMPTY;
 
 	return n;
 }
 
-void eraseLiberty(std::set<Vertex> *const liberties, const Vertex & v)
+void connect(Board *const b, ChainMap *const cm, std::vector<chain_t *> *const chainsWhite, std::vector<chain_t *> *const chainsBlack, const board_t what, const int x, const int y)
 {
-	liberties->erase(v);
+	selectForDim(b->getDim(), [&]<int DIM>() { connectKernel<DIM>(b, cm, chainsWhite, chainsBlack, what, x, y); });
 }
 
-void connect(Board *const b, ChainMap *const cm, std::vector<chain_t *> *const chainsWhite, std::vector<chain_t *> *const chainsBlack, const board_t what, const int x, const int y)
+template <int DIM>
+static void connectKernel(Board *const b, ChainMap *const cm, std::vector<chain_t *> *const chainsWhite, std::vector<chain_t *> *const chainsBlack, const board_t what, const int x, const int y)
 {
-	const int dim   = b->getDim();
-	const int dimm1 = dim - 1;
+	const int dim   = DIM ? DIM : b->getDim();
+	const int pdim  = dim + 2;
 
 	assert(x >= 0 && x < dim);
 	assert(y >= 0 && y < dim);
 
-	Vertex v(x, y, dim);
+	const int  v        = y * dim + x;
+	const int  pv       = (y + 1) * pdim + x + 1;
+	const int  offsets[] { -pdim, +pdim, -1, +1 };
+	const int  uoffsets[] { -dim, +dim, -1, +1 };  // same neighbours, unpadded
 
 	// update board
-	assert(b->getAt(x, y) == B_EMPTY);
+	assert(b->getAtPadded(pv) == B_EMPTY);
 	b->setAt(v, what);
 
-	// determine the adjacent fields
-	std::vector<Vertex> adjacent = getAdjacentVertexes(x, y, dim);
-
 	// find chains to merge
 	// also remove the cross underneath the new stone of all chain-liberties
-	std::set<chain_t *> toMergeTemp;
+	chain_t *toMerge[4] { nullptr };
+	int      nToMerge   { 0       };
 
-	for(auto & vScan : adjacent) {
-		auto p = cm->getAt(vScan);
+	for(int i=0; i<4; i++) {
+		auto p = cm->getAtPadded(pv + offsets[i]);
 
 		if (p) {
 			p->liberties.erase(v);
 
-			if (p->type == what)
-				toMergeTemp.insert(p);
+			if (p->type == what && std::find(toMerge, toMerge + nToMerge, p) == toMerge + nToMerge)
+				toMerge[nToMerge++] = p;
 		}
 	}
 
-	std::vector<chain_t *> toMerge;
-	for(auto & chain : toMergeTemp)
-		toMerge.emplace_back(chain);
-
-	bool rescanGlobalLiberties = false;
+	chain_t *target = nullptr;
 
 	// add new piece to (existing) first chain (of the set of chains found to be merged)
-	if (toMerge.empty() == false) {
+	if (nToMerge) {
+		target = toMerge[0];
+
 		// add to chain
-		toMerge.at(0)->chain.emplace_back(v);
+		target->chain.emplace_back(v);
 		// update board->chain map
-		cm->setAt(v, toMerge.at(0));
+		cm->setAtPadded(pv, target);
 
 		// merge
 		auto cleanChainSet = what == B_WHITE ? chainsWhite : chainsBlack;
 
-		for(size_t i=1; i<toMerge.size(); i++) {
-			toMerge.at(0)->chain.insert(toMerge.at(0)->chain.end(), std::make_move_iterator(toMerge.at(i)->chain.begin()), std::make_move_iterator(toMerge.at(i)->chain.end()));  // add stones
+		for(int i=1; i<nToMerge; i++) {
+			for(auto & stone : toMerge[i]->chain)
+				cm->setAt(stone, target);
+
+			target->chain.insert(target->chain.end(), toMerge[i]->chain.begin(), toMerge[i]->chain.end());  // add stones
 
-			toMerge.at(0)->liberties.merge(toMerge.at(i)->liberties);  // add empty crosses surrounding the chain
+			target->liberties.merge(toMerge[i]->liberties);  // add empty crosses surrounding the chain
 
 			// remove chain from chainset
-			auto it = std::find(cleanChainSet->begin(), cleanChainSet->end(), toMerge.at(i));
-			delete *it;
+			auto it = std::find(cleanChainSet->begin(), cleanChainSet->end(), toMerge[i]);
+			freeChain(*it);
 			cleanChainSet->erase(it);
 		}
-
-		// update cm
-		if (toMerge.size() > 1) {
-			auto workOn = toMerge.at(0);  // at this point, entry 1... have been merged in 0
-
-			for(auto & stone : workOn->chain)
-				cm->setAt(stone, workOn);
-		}
-
-		// add any new liberties
-		getLiberty(*cm, x, y, what, &toMerge.at(0)->liberties);
 	}
 	else {
 		// this is a new chain
-		chain_t *curChain = new chain_t;
-		curChain->type = what;
-		curChain->chain.emplace_back(v);
+		target = allocChain(what, dim);
+		target->chain.emplace_back(v);
 
 		if (what == B_WHITE)
-			chainsWhite->emplace_back(curChain);
+			chainsWhite->emplace_back(target);
 		else // if (what == B_BLACK)
-			chainsBlack->emplace_back(curChain);
+			chainsBlack->emplace_back(target);
 
-		cm->setAt(v, curChain);
+		cm->setAtPadded(pv, target);
+	}
 
-		// find any liberties around it
-		getLiberty(*cm, x, y, what, &curChain->liberties);
+	// add any new liberties
+	for(int i=0; i<4; i++) {
+		if (b->getAtPadded(pv + offsets[i]) == B_EMPTY)
+			target->liberties.insert(v + uoffsets[i]);
 	}
 
 	// find surrounding opponent chains of the current position to remove them
 	// if they're now dead
-	for(auto & vScan : adjacent) {
-		auto p = cm->getAt(vScan);
+	for(int i=0; i<4; i++) {
+		auto p = cm->getAtPadded(pv + offsets[i]);
 
 		if (!p || p->liberties.empty() == false || p->type == what)
 			continue;
@@ -597,31 +1409,13 @@ void connect(Board *const b, ChainMap *const cm, std::vector<chain_t *> *const c
 		for(auto ve : p->chain) {
 			b->setAt(ve, B_EMPTY);
 
-			cm->setAt(ve, nullptr);
+			const int pve = toPadded(ve, dim);
 
-			const int x = ve.getX();
-			const int y = ve.getY();
+			cm->setAtPadded(pve, nullptr);
 
-			if (x) {
-				auto p = cm->getAt(x - 1, y);
-				if (p)
-					p->liberties.insert(ve);
-			}
-
-			if (x < dimm1) {
-				auto p = cm->getAt(x + 1, y);
-				if (p)
-					p->liberties.insert(ve);
-			}
+			for(int j=0; j<4; j++) {
+				auto p = cm->getAtPadded(pve + offsets[j]);
 
-			if (y) {
-				auto p = cm->getAt(x, y - 1);
-				if (p)
-					p->liberties.insert(ve);
-			}
-
-			if (y < dimm1) {
-				auto p = cm->getAt(x, y + 1);
 				if (p)
 					p->liberties.insert(ve);
 			}
@@ -632,7 +1426,7 @@ void connect(Board *const b, ChainMap *const cm, std::vector<chain_t *> *const c
 		else
 			chainsBlack->erase(std::find(chainsBlack->begin(), chainsBlack->end(), p));
 
-		delete p;
+		freeChain(p);
 	}
 }
 
@@ -646,22 +1440,7 @@ void purgeChainsWithoutLiberties(Board *const b, const std::vector<chain_t *> &
 	}
 }
 
-void play(Board *const b, const Vertex & v, const player_t & p)
+void play(Board *const b, const point_t v, const player_t & p)
 {
-	board_t stone_type = playerToStone(p);
-
-	b->setAt(v, stone_type);
-
-	ChainMap cm(b->getDim());
-
-	std::vector<chain_t *> chainsWhite, chainsBlack;
-
-	findChains(*b, &chainsWhite, &chainsBlack, &cm);
-
-	std::vector<chain_t *> & scan = p == P_BLACK ? chainsWhite : chainsBlack;
-
-	purgeChainsWithoutLiberties(b, scan);
-
-	purgeChains(&chainsBlack);
-	purgeChains(&chainsWhite);
+	b->play(v, playerToStone(p));
 }
@@ -4,27 +4,187 @@
 #include <set>
 #include <stdint.h>
 #include <string>
-#include <unordered_set>
 #include <vector>
 
+#include "bitboard.h"
 #include "vertex.h"
+#include "vertexset.h"
 #include "zobrist.h"
 
 
 typedef enum { P_BLACK = 0, P_WHITE } player_t;
 
-typedef enum { B_EMPTY, B_WHITE, B_BLACK, B_LAST } board_t;
+typedef enum { B_EMPTY, B_WHITE, B_BLACK, B_EDGE, B_LAST } board_t;
 
 const char *board_t_name(const board_t v);
 
+// internally, the board is surrounded by a one cross wide border (B_EDGE)
+// "padded" indexes are into that (dim + 2) x (dim + 2) layout
+inline int toPadded(const int v, const int dim)
+{
+	return v + (v / dim) * 2 + dim + 3;
+}
+
+inline int fromPadded(const int pv, const int dim)
+{
+	const int pdim = dim + 2;
+
+	return (pv / pdim - 1) * dim + pv % pdim - 1;
+}
+
+typedef struct {
+	board_t type;
+	std::vector<point_t> chain;
+	VertexSet           liberties;
+} chain_t;
+
+// chains come from a per-thread pool: freed chains are kept (with the
+// capacity of their "chain" vector) for re-use instead of going back to the heap
+chain_t *allocChain(const board_t type, const int dim);
+void freeChain(chain_t *const chain);
+
+class ChainMap;
+
+// a connected area of empty crosses and stones of "owner", see findRegions()
+// "enclosed": not on the edge and with only one opponent chain around it
+typedef struct {
+	board_t                owner;
+	int                    nEmpty;
+	int                    nStones;
+	std::vector<chain_t *> borders;  // the opponent chains touching the region
+	bool                   touchesEdge;
+	bool                   enclosed;
+} region_t;
+
+// a findLiberties() implementation, specialised for a board size
+typedef void (*find_liberties_t)(const ChainMap & cm, std::vector<point_t> *const empties, const board_t for_whom);
+
+class ChainMap {
+private:
+	const int              dim      { 0       };
+	const int              pdim     { 0       };
+	chain_t **const        cm       { nullptr };  // padded
+	const find_liberties_t findLib  { nullptr };  // selected once, from dim
+
+	// filled in by findRegions(); "regions" is only ever grown so that the
+	// "borders" vectors keep their capacity
+	int *const             region   { nullptr };  // padded, index in "regions" or -1
+	std::vector<region_t>  regions;
+	int                    nRegions { 0       };
+
+public:
+	ChainMap(const int dim);
+	virtual ~ChainMap();
+
+	bool getEnclosed(const int v) const;
+
+	const region_t * getRegionAt(const int v) const;  // nullptr for opponent stones
+	int getRegionIndexAtPadded(const int pv) const;
+	void setRegionAtPadded(const int pv, const int index);
+	int getNRegions() const;
+	const region_t & getRegion(const int index) const;
+	region_t * addRegion(const board_t owner);
+	void resetRegions();
+
+	int getDim() const;
+	int getPaddedDim() const;
+	find_liberties_t getFindLiberties() const;
+
+	chain_t * getAt(const int v) const;
+	chain_t * getAt(const int x, const int y) const;
+	chain_t * getAtPadded(const int pv) const;
+
+	void setAt(const int v, chain_t *const chain);
+	void setAt(const int x, const int y, chain_t *const chain);
+	void setAtPadded(const int pv, chain_t *const chain);
+
+	void reset();
+};
+
+// what is needed by Board::unplay() to take back a move (or a pass)
+typedef struct {
+	bool                 is_pass;
+	point_t              v;
+	uint64_t             hash;
+	uint32_t             capturedStart;  // into Board::captured
+	uint32_t             nCaptured;
+	board_t              toMove;
+	int                  koPoint;
+	int                  passes;
+} undo_t;
+
+// the legal moves in a position, see Board::generateMoves()
+// fixed capacity so that it can live on the stack of a search or playout
+typedef struct {
+	point_t moves[MAX_DIM * MAX_DIM];
+	int     n;
+} move_list_t;
+
 class Board {
 private:
-	Zobrist *const z    { nullptr };
-	int            dim  { 0       };
-	board_t       *b    { nullptr };
-	uint64_t       hash { 0       };
+	Zobrist *const z          { nullptr };
+	int            dim        { 0       };
+	int            pdim       { 0       };
+	board_t       *b          { nullptr };  // padded
+	uint64_t       hash       { 0       };
+	int            nStones    { 0       };
+	int            offsets[4] { 0       };  // to the neighbours of a padded index
+
+	// the same stones as "b", as bitplanes (only for boards up to BITBOARD_MAX_DIM)
+	bitplane_t     planeBlack { };
+	bitplane_t     planeWhite { };
+	bool           hasPlanes  { false   };
+
+	// chains & their liberties, kept up to date by play()
+	// when stones are placed directly (setAt), they're rebuilt on demand
+	ChainMap                      *cm          { nullptr };
+	mutable std::vector<chain_t *> chainsWhite;
+	mutable std::vector<chain_t *> chainsBlack;
+	mutable bool                   chainsValid { false   };
+
+	// not copied: a copy can't take back moves made on the original
+	std::vector<undo_t>            undos;
+	size_t                         nUndos      { 0       };
+	// the stones captured by the moves in "undos", one after the other
+	std::vector<point_t>           captured;
+
+	// next to the stones: who is to move, the simple ko point (-1 if none)
+	// and the number of consecutive passes, see getKey()
+	board_t                        toMove      { B_BLACK };
+	int                            koPoint     { -1      };
+	int                            passes      { 0       };
+	uint64_t                       stateHash   { 0       };
+
+	// the (stone-)hashes of all positions before the current one, for positional superko
+	// historyIndex is an open addressing table of indexes (+ 1) into history
+	std::vector<uint64_t>          history;
+	std::vector<uint32_t>          historyIndex;
+	// the number of positions in "history" per number of stones: a move giving
+	// a stone count that no earlier position had can't repeat one
+	uint32_t                       historyStones[MAX_DIM * MAX_DIM + 1] { 0 };
 
 	uint64_t getHashForField(const int v);
+	void putStone(const int v, const int pv, const board_t bv);
+	void updateStateHash();
+
+	void historyPush(const uint64_t h);
+	void historyPop();
+
+	// the hot loops, as a template on the board size (see selectForDim()) and
+	// the version of each for the size of this board
+	template <int DIM> bool isLegalPadded(const int pv, const point_t v, const board_t what) const;
+	template <int DIM> void generateMovesKernel(const board_t what, move_list_t *const out) const;
+	template <int DIM> void playKernel(const point_t v, const board_t what);
+
+	bool (Board::*isLegalImpl)(const int pv, const point_t v, const board_t what) const { nullptr };
+	void (Board::*generateMovesImpl)(const board_t what, move_list_t *const out) const  { nullptr };
+	void (Board::*playImpl)(const point_t v, const board_t what)                        { nullptr };
+
+	void selectKernels();
+	void initPadding();
+	void copyChains(const Board & bIn);
+	void validateChains() const;
+	chain_t *rebuildChain(const int pv_start);
 
 public:
 	Board(Zobrist *const z, const int dim);
@@ -32,55 +192,64 @@ public:
 	Board(const Board & bIn);
 	~Board();
 
+	// becomes a copy of "bIn" (of the same dimensions) in the buffers this
+	// board already has: no heap allocations once these are large enough
+	// the moves made on this board can no longer be taken back
+	void assign(const Board & bIn);
+
 	int getDim() const;
+	int getPaddedDim() const;
+	const int *getNeighbourOffsets() const;
 	void getTo(board_t *const bto) const;
 	board_t getAt(const int v) const;
 	board_t getAt(const Vertex & v) const;
 	board_t getAt(const int x, const int y) const;
+	board_t getAtPadded(const int pv) const;
+	// of the stones only
 	uint64_t getHash() const;
+	// getHash() + side to move, ko point and passes
+	uint64_t getKey() const;
+
+	board_t getToMove() const;
+	int getKoPoint() const;
+	int getPasses() const;
+	void setState(const board_t toMove, const int passes);
+
+	// the hash the board would have after playing "v", without playing it
+	uint64_t getHashAfter(const point_t v, const board_t what) const;
+	bool isInHistory(const uint64_t h) const;
+	// did the last move repeat an earlier position?
+	bool isRepetition() const;
+	// would playing "v" repeat an earlier position? (positional superko)
+	bool wouldRepeat(const point_t v, const board_t what) const;
+	// not occupied, not suicide and not repeating an earlier position
+	bool isLegal(const point_t v, const board_t what) const;
+	void generateMoves(const board_t what, move_list_t *const out) const;
 
 	void setAt(const int v, const board_t bv);
 	void setAt(const Vertex & v, const board_t bv);
 	void setAt(const int x, const int y, const board_t bv);
-};
 
+	bool hasBitplanes() const;
+	const bitplane_t & getPlane(const board_t bv) const;
 
-typedef struct {
-	board_t type;
-	std::vector<Vertex> chain;
-	std::unordered_set<Vertex, Vertex::HashFunction> liberties;
-} chain_t;
+	const ChainMap & getChainMap() const;
+	const std::vector<chain_t *> & getChainsWhite() const;
+	const std::vector<chain_t *> & getChainsBlack() const;
 
-class ChainMap {
-private:
-	const int       dim      { 0       };
-	chain_t **const cm       { nullptr };
-	bool *const     enclosed { nullptr };
-
-public:
-	ChainMap(const int dim);
-	virtual ~ChainMap();
-
-	bool getEnclosed(const int v) const;
-	void setEnclosed(const int v);
-
-	int getDim() const;
-
-	chain_t * getAt(const int v) const;
-	chain_t * getAt(const Vertex & v) const;
-	chain_t * getAt(const int x, const int y) const;
-
-	void setAt(const Vertex & v, chain_t *const chain);
-	void setAt(const int x, const int y, chain_t *const chain);
+	void play(const point_t v, const board_t what);
+	void pass();
+	// takes back the last play() or pass()
+	void unplay();
 };
 
 void findChainsScan(std::queue<std::pair<unsigned, unsigned> > *const work_queue, const Board & b, unsigned x, unsigned y, const int dx, const int dy, const board_t type, bool *const scanned);
-void pickEmptyAround(const ChainMap & cm, const Vertex & v, std::unordered_set<Vertex, Vertex::HashFunction> *const target);
-void pickEmptyAround(const Board & b, const Vertex & v, std::unordered_set<Vertex, Vertex::HashFunction> *const target);
+void pickEmptyAround(const ChainMap & cm, const point_t v, VertexSet *const target);
+void pickEmptyAround(const Board & b, const point_t v, VertexSet *const target);
 void findChains(const Board & b, std::vector<chain_t *> *const chainsWhite, std::vector<chain_t *> *const chainsBlack, ChainMap *const cm);
-void findLiberties(const ChainMap & cm, std::vector<Vertex> *const empties, const board_t for_whom);
-void scanEnclosed(const Board & b, ChainMap *const cm, const board_t myType);
+void findLiberties(const ChainMap & cm, std::vector<point_t> *const empties, const board_t for_whom);
+void findRegions(const Board & b, ChainMap *const cm, const board_t myType);
 void purgeChains(std::vector<chain_t *> *const chains);
 void connect(Board *const b, ChainMap *const cm, std::vector<chain_t *> *const chainsWhite, std::vector<chain_t *> *const chainsBlack, const board_t what, const int x, const int y);
 void purgeChainsWithoutLiberties(Board *const b, const std::vector<chain_t *> & chains);
-void play(Board *const b, const Vertex & v, const player_t & p);
+void play(Board *const b, const point_t v, const player_t & p);
@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <assert.h>
 #include <atomic>
+#include <chrono>
 #include <climits>
 #include <condition_variable>
 #include <cstdint>
@@ -25,22 +26,30 @@
 #include <sys/resource.h>
 #include <sys/time.h>
 
+#ifdef COUNT_ALLOCS
+#include "alloc.h"
+#endif
+#include "alphabeta.h"
 #include "board.h"
 #include "dump.h"
 #include "fifo.h"
 #include "helpers.h"
 #include "io.h"
+#include "lfqueue.h"
+#include "mcts.h"
+#include "playout.h"
+#include "pool.h"
 #include "random.h"
 #include "score.h"
 #include "str.h"
 #include "time.h"
+#include "timemgr.h"
+#include "tt.h"
 #include "unittest.h"
 #include "vertex.h"
 #include "zobrist.h"
 
 
-//#define CALC_BCO
-
 Zobrist z(19);
 
 typedef struct {
@@ -48,10 +57,10 @@ typedef struct {
 	bool valid;
 } eval_t;
 
-inline bool isValidMove(const std::vector<chain_t *> & liberties, const Vertex & v)
+inline bool isValidMove(const std::vector<chain_t *> & liberties, const point_t v)
 {
 	for(auto chain : liberties) {
-		if (chain->liberties.find(v) != chain->liberties.end())
+		if (chain->liberties.contains(v))
 			return true;
 	}
 
@@ -59,12 +68,12 @@ inline bool isValidMove(const std::vector<chain_t *> & liberties, const Vertex &
 }
 
 // valid & not enclosed
-bool isUsable(const ChainMap & cm, const std::vector<chain_t *> & liberties, const Vertex & v)
+bool isUsable(const ChainMap & cm, const std::vector<chain_t *> & liberties, const point_t v)
 {
-	return isValidMove(liberties, v) && cm.getEnclosed(v.getV()) == false;
+	return isValidMove(liberties, v) && cm.getEnclosed(v) == false;
 }
 
-void selectRandom(const Board & b, const ChainMap & cm, const std::vector<chain_t *> & chainsWhite, const std::vector<chain_t *> & chainsBlack, std::vector<Vertex> & liberties, const player_t & p, std::vector<eval_t> *const evals)
+void selectRandom(const Board & b, const ChainMap & cm, const std::vector<chain_t *> & chainsWhite, const std::vector<chain_t *> & chainsBlack, std::vector<point_t> & liberties, const player_t & p, std::vector<eval_t> *const evals)
 {
 	size_t chainSize = liberties.size();
 
@@ -81,13 +90,13 @@ void selectRandom(const Board & b, const ChainMap & cm, const std::vector<chain_
 	for(size_t i=0; i<r; i++)
 		it++;
 
-	const int v = it->getV();
+	const int v = *it;
 
 	evals->at(v).score++;
 	evals->at(v).valid = true;
 }
 
-void selectExtendChains(const Board & b, const ChainMap & cm, const std::vector<chain_t *> & chainsWhite, const std::vector<chain_t *> & chainsBlack, std::vector<Vertex> & liberties, const player_t & p, std::vector<eval_t> *const evals)
+void selectExtendChains(const Board & b, const ChainMap & cm, const std::vector<chain_t *> & chainsWhite, const std::vector<chain_t *> & chainsBlack, std::vector<point_t> & liberties, const player_t & p, std::vector<eval_t> *const evals)
 {
 	const std::vector<chain_t *> & scan = p == P_BLACK ? chainsWhite : chainsBlack;
 
@@ -95,12 +104,12 @@ void selectExtendChains(const Board & b, const ChainMap & cm, const std::vector<
 
 	for(auto chain : scan) {
 		for(auto chainStone : chain->chain) {
-			std::unordered_set<Vertex, Vertex::HashFunction> empties;
+			VertexSet empties(cm.getDim());
 			pickEmptyAround(cm, chainStone, &empties);
 
 			for(auto cross : empties) {
 				if (isUsable(cm, myLiberties, cross)) {  // TODO: redundant check?
-					int v = cross.getV();
+					int v = cross;
 					evals->at(v).score += 2;
 					evals->at(v).valid = true;
 				}
@@ -109,7 +118,7 @@ void selectExtendChains(const Board & b, const ChainMap & cm, const std::vector<
 	}
 }
 
-void selectKillChains(const Board & b, const ChainMap & cm, const std::vector<chain_t *> & chainsWhite, const std::vector<chain_t *> & chainsBlack, std::vector<Vertex> & liberties, const player_t & p, std::vector<eval_t> *const evals)
+void selectKillChains(const Board & b, const ChainMap & cm, const std::vector<chain_t *> & chainsWhite, const std::vector<chain_t *> & chainsBlack, std::vector<point_t> & liberties, const player_t & p, std::vector<eval_t> *const evals)
 {
 	const std::vector<chain_t *> & scan = p == P_BLACK ? chainsBlack : chainsWhite;
 	const std::vector<chain_t *> & myLiberties = p == P_BLACK ? chainsBlack : chainsWhite;
@@ -119,7 +128,7 @@ void selectKillChains(const Board & b, const ChainMap & cm, const std::vector<ch
 
 		for(auto stone : chain->liberties) {
 			if (isUsable(cm, myLiberties, stone)) {
-				int v = stone.getV();
+				int v = stone;
 				evals->at(v).score += add;
 				evals->at(v).valid = true;
 			}
@@ -127,7 +136,7 @@ void selectKillChains(const Board & b, const ChainMap & cm, const std::vector<ch
 	}
 }
 
-void selectAtLeastOne(const Board & b, const ChainMap & cm, const std::vector<chain_t *> & chainsWhite, const std::vector<chain_t *> & chainsBlack, std::vector<Vertex> & liberties, const player_t & p, std::vector<eval_t> *const evals)
+void selectAtLeastOne(const Board & b, const ChainMap & cm, const std::vector<chain_t *> & chainsWhite, const std::vector<chain_t *> & chainsBlack, std::vector<point_t> & liberties, const player_t & p, std::vector<eval_t> *const evals)
 {
 	const std::vector<chain_t *> & myLiberties = p == P_BLACK ? chainsBlack : chainsWhite;
 
@@ -135,7 +144,7 @@ void selectAtLeastOne(const Board & b, const ChainMap & cm, const std::vector<ch
 		return;
 
 	auto      it = myLiberties.at(0)->liberties.begin();
-	const int v = it->getV();
+	const int v = *it;
 
 	evals->at(v).score++;
 	evals->at(v).valid = true;
@@ -161,285 +170,119 @@ int calcNLiberties(const std::vector<chain_t *> & chains)
 	return n;
 }
 
-typedef struct
-{
-	std::atomic_bool        flag;
-	std::condition_variable cv;
-}
-end_indicator_t;
+// the best move of the running search so far (-1: none yet), for the watchdog
+std::atomic_int searchBest { -1 };
 
-#ifdef CALC_BCO
-double bco_total = 0;
-uint64_t bco_n = 0;
-#endif
-
-int search(const Board & b, const player_t & p, int alpha, const int beta, const int depth, const double komi, const uint64_t end_t, end_indicator_t *const ei, std::atomic_bool *const quick_stop)
+void selectAlphaBeta(const Board & b, const ChainMap & cm, const std::vector<chain_t *> & chainsWhite, const std::vector<chain_t *> & chainsBlack, std::vector<point_t> & liberties, const player_t & p, std::vector<eval_t> *const evals, const time_budget_t & budget, const uint64_t start_t, const double komi, ThreadPool *const pool, TranspositionTable *const tt, const Deadline *const hardStop)
 {
-	if (ei->flag || *quick_stop)
-		return -32767;
-
-	if (depth == 0) {
-		auto s = score(b, komi);
-		return p == P_BLACK ? s.first - s.second : s.second - s.first;
-	}
-
-	ChainMap cm(b.getDim());
-	std::vector<chain_t *> chainsWhite, chainsBlack;
-	findChains(b, &chainsWhite, &chainsBlack, &cm);
-
-	std::vector<Vertex> liberties;
-	findLiberties(cm, &liberties, playerToStone(p));
-
-	// no valid liberties? return score (eval)
-	if (liberties.empty()) {
-		purgeChains(&chainsBlack);
-		purgeChains(&chainsWhite);
-
-		auto s = score(b, komi);
-		return p == P_BLACK ? s.first - s.second : s.second - s.first;
-	}
-
-	int bestScore = -32768;
-	std::optional<Vertex> bestMove;
-
-	player_t opponent = getOpponent(p);
-
-#ifdef CALC_BCO
-	int bco = 0;
-#endif
-
-	for(auto stone : liberties) {
-		// TODO: check if in liberties van de mogelijke crosses van p
-#ifdef CALC_BCO
-		bco++;
-#endif
-
-		Board work(b);
-
-		play(&work, stone, p);
-
-		int score = -search(work, opponent, -beta, -alpha, depth - 1, komi, end_t, ei, quick_stop);
-
-		if (score > bestScore) {
-			bestScore = score;
-			bestMove.emplace(stone);
-
-			if (score > alpha) {
-				alpha = score;
-
-				if (score >= beta)
-					goto finished;
-			}
-		}
-	}
-
-finished:
-#ifdef CALC_BCO
-	bco_total += double(bco) / nLiberties;
-	bco_n++;
-#endif
-
-	purgeChains(&chainsBlack);
-	purgeChains(&chainsWhite);
-
-	return bestScore;
-}
-
-void timer(int think_time, end_indicator_t *const ei)
-{
-	if (think_time > 0) {
-		std::mutex m;
-		std::unique_lock<std::mutex> lk(m);
-
-		for(;;) {
-			if (ei->cv.wait_for(lk, std::chrono::milliseconds(think_time)) == std::cv_status::timeout) {
-				ei->flag = true;
-				break;
-			}
+	const int dim = b.getDim();
 
-			if (ei->flag)
-				break;
-		}
-	}
-	else {
-		ei->flag = true;
-	}
-}
+	bool *valid = new bool[dim * dim]();
 
-struct CompareCrossesSortHelper {
-	const Board & b;
-	const int dim;
-	const player_t p;
+	int n_work = liberties.size();
 
-	CompareCrossesSortHelper(const Board & b, const player_t & p) : b(b), dim(b.getDim()), p(p) {
-	}
+	// root moves by the score right after them; each move is scored once
+	std::vector<std::pair<int, point_t> > places_for_sort;
 
-	int getScore(const int move) {
-		Board work(b);
+	Board sort_board(b);
 
-		play(&work, { move, dim }, p);
+	for(auto & v : liberties) {
+		play(&sort_board, v, p);
 
-		auto s = score(work, 0.);
+		auto s = score(sort_board, 0.);
 
-		return p == P_BLACK ? s.first - s.second : s.second - s.first;
-	}
+		sort_board.unplay();
 
-	bool operator()(int i, int j) {
-		return getScore(i) > getScore(j);
+		places_for_sort.emplace_back(p == P_BLACK ? s.first - s.second : s.second - s.first, v);
 	}
-};
-
-void selectAlphaBeta(const Board & b, const ChainMap & cm, const std::vector<chain_t *> & chainsWhite, const std::vector<chain_t *> & chainsBlack, std::vector<Vertex> & liberties, const player_t & p, std::vector<eval_t> *const evals, const double useTime, const double komi, const int nThreads)
-{
-	const int dim = b.getDim();
 
-	bool *valid = new bool[dim * dim]();
-
-	int n_work = 0;
-
-	std::vector<int> places_for_sort;
+	std::stable_sort(places_for_sort.begin(), places_for_sort.end(), [](const auto & a, const auto & b) { return a.first > b.first; });
 
-	for(auto & v : liberties)
-		places_for_sort.emplace_back(v.getV()), n_work++;
+	send(true, "# work: %d, time: %f (at most %f)", n_work, budget.target, budget.limit);
 
-	std::sort(places_for_sort.begin(), places_for_sort.end(), CompareCrossesSortHelper(b, p));
+	move_list_t rootMoves;
+	rootMoves.n = 0;
 
-	send(true, "# work: %d, time: %f", n_work, useTime);
+	for(auto & v : places_for_sort)
+		rootMoves.moves[rootMoves.n++] = v.second;
 
-	uint64_t start_t = get_ts_ms();  // TODO: start of genMove()
-	uint64_t hend_t  = start_t + useTime * 1000 / 2;
-	uint64_t end_t   = start_t + useTime * 1000;
+	tt->newSearch();
 
-	end_indicator_t ei { false };
-	std::thread *to_timer = new std::thread(timer, end_t - start_t, &ei);
+	ordering_t ordering;
+	orderingClear(&ordering);
 
 	int depth = 1;
 	bool ok = false;
 
 	std::optional<int> global_best;
+	std::optional<int> previous_score;
 
-	int alpha = -32767;
-	int beta  =  32767;
-	std::mutex a_b_lock;
-
-	while(get_ts_ms() < hend_t && depth <= dim * dim) {
-		send(true, "# a/b depth: %d", depth);
-
-		fifo<int> places(dim * dim + 1);
-
-		// queue "work" for threads
-		for(auto & v: places_for_sort)
-			places.put(v);
-
-		std::atomic_bool quick_stop { false };
-
-		bool allow_next_depth = true;
-
-		ok = false;
+	uint64_t nodes = 0;
 
-		std::vector<std::thread *> threads;
+	int  stable    = 0;      // number of depths that agreed on the best move
+	bool unsettled = false;  // best move or score changed at the last depth
 
-		std::vector<std::optional<std::pair<int, int> > > best;
-		best.resize(nThreads);
-
-		for(int i=0; i<nThreads; i++) {
-			threads.push_back(new std::thread([hend_t, end_t, &places, dim, b, p, depth, komi, &ei, &alpha, beta, &a_b_lock, &quick_stop, i, &best, &ok, &allow_next_depth] {
-						int local_alpha = alpha;
-						int local_beta  = beta;
-
-						for(;;) {
-							int time_left = hend_t - get_ts_ms();
-							if (time_left <= 0 || ei.flag)
-								break;
-
-							auto v = places.try_get();
-
-							if (v.has_value() == false) {
-								ok = true;
-								break;
-							}
-
-							Board work(b);
-
-							play(&work, { v.value(), dim }, p);
-
-							int score = search(work, p == P_BLACK ? P_WHITE : P_BLACK, local_alpha, local_beta, depth, komi, end_t, &ei, &quick_stop);
-
-							std::unique_lock<std::mutex> lck(a_b_lock);
-
-							if (ei.flag == false && score > alpha) {
-								alpha = score;
+	// iterative deepening; a depth that does not finish in time is of no use
+	while(depth <= dim * dim) {
+		send(true, "# a/b depth: %d", depth);
 
-								best[i] = { v.value(), score };
+		// when unsettled, the depth may run into the extension
+		Deadline stop(start_t + (unsettled ? budget.limit : budget.target) * 1000, hardStop);
 
-								if (score >= beta) {
-									send(true, "BCO: %d %d %d\n", alpha, score, beta);
-									quick_stop = true;
-									ok = true;
-									break;
-								}
+		auto result = searchAspiration(b, p, depth, previous_score, komi, rootMoves, pool, tt, &ordering, stop);
 
-							}
+		uint64_t now = get_ts_ms();
 
-							if (score <= alpha) {
-								alpha = -32767;
+		nodes += result.nodes;
 
-								allow_next_depth = false;
-							}
+		ok = result.completed;
 
-							local_alpha = alpha;
-							local_beta  = beta;
-						}
-					}));
-		}
+		if (ok == false)
+			break;
 
-		send(true, "# %zu threads", threads.size());
+		const bool score_jumped = previous_score.has_value() && std::abs(result.score - previous_score.value()) > 2;
 
-		while(threads.empty() == false) {
-			(*threads.begin())->join();
+		previous_score = result.score;
 
-			send(true, "# thread terminated, %zu left", threads.size());
+		if (result.move.has_value()) {
+			if (global_best == result.move.value())
+				stable++;
+			else
+				stable = 0;
 
-			delete *threads.begin();
+			global_best = result.move.value();
+			searchBest  = global_best.value();
 
-			threads.erase(threads.begin());
+			send(true, "# Move selected for this depth: %s (%d), score: %d", v2t(Vertex(global_best.value(), dim)).c_str(), global_best.value(), result.score);
 		}
 
-		int                best_score = -32767;
-		std::optional<int> best_move;
+		depth++;
 
-		for(size_t i=0; i<best.size(); i++) {
-			if (best.at(i).has_value() && best.at(i).value().second > best_score) {
-				best_move  = best.at(i).value().first;
-				best_score = best.at(i).value().second;
+		const double elapsed = now - start_t;
 
-				send(true, "# thread %zu chose %s with score %d", i, v2t(Vertex(best_move.value(), dim)).c_str(), best_score);
-			}
+		// the same move for a couple of depths: no need to use all of the time
+		if (stable >= 3 && elapsed >= budget.target * 1000 / 4) {
+			send(true, "# a/b: best move stable for %d depths, stopping after %.3fs", stable + 1, elapsed / 1000);
+			break;
 		}
 
-		if (best_score > alpha)
-			alpha = best_score;
+		// a next depth takes (much) longer than all before it together: it
+		// is only started in the first half of the time; when the best move
+		// or score just changed, that of the extension
+		unsettled = depth > 3 && (stable == 0 || score_jumped);
 
-		if (ok && ei.flag == false && best_move.has_value()) {
-			global_best = best_move;
+		const double allowed = unsettled ? budget.limit : budget.target;
 
-			send(true, "# Move selected for this depth: %s (%d)", v2t(Vertex(global_best.value(), dim)).c_str(), global_best.value());
-		}
+		if (elapsed >= allowed * 1000 / 2)
+			break;
 
-		if (allow_next_depth)
-			depth++;
-		else
-			send(true, "# score outside window, retry depth");
+		if (unsettled && elapsed >= budget.target * 1000 / 2)
+			send(true, "# a/b: best move not settled, extending to depth %d", depth);
 	}
 
-	if (to_timer) {
-		ei.flag = true;
-		ei.cv.notify_one();
+	uint64_t took = std::max(uint64_t(1), get_ts_ms() - start_t);
 
-		to_timer->join();
-
-		delete to_timer;
-	}
+	send(true, "# %lu nodes in %lu ms on %d threads: %.1f nodes/s", nodes, took, pool->getN(), nodes * 1000. / took);
 
 	if (global_best.has_value()) {
 		send(true, "# Move selected for %c by A/B: %s (reached depth: %d, completed: %d)", p == P_BLACK ? 'B' : 'W', v2t(Vertex(global_best.value(), dim)).c_str(), depth, ok);
@@ -449,209 +292,209 @@ void selectAlphaBeta(const Board & b, const ChainMap & cm, const std::vector<cha
 	}
 
 #ifdef CALC_BCO
-	double factor = bco_total / bco_n;
-	send(true, "# BCO at %.3f%%; move %d, n: %lu", factor * 100, int(factor * dim * dim), bco_n);
+	double factor = getBCO();
+	send(true, "# BCO at %.3f%%; move %d, n: %lu", factor * 100, int(factor * dim * dim), getBCOn());
 #endif
 
 	delete [] valid;
 }
 
-std::tuple<double, double, int> playout(const Board & in, const double komi, player_t p)
-{
-	Board b(in);
-
-	const int dim = b.getDim();
-
-	// find chains of stones
-	ChainMap cm(dim);
-	std::vector<chain_t *> chainsWhite, chainsBlack;
-	findChains(b, &chainsWhite, &chainsBlack, &cm);
+// the search tree, kept between moves so that a search can continue where
+// the previous one (for an earlier position) left off
+typedef struct {
+	mcts_node_t root;
+	uint64_t    key    { 0       };  // Board::getKey() of the position at the root
+	player_t    player { P_BLACK };  // to move at the root
+	int         dim    { 0       };  // the key does not tell board sizes apart
+} search_tree_t;
 
-	std::unordered_set<uint64_t> seen;
-	seen.insert(b.getHash());
+search_tree_t searchTree;
 
-	int  mc      { 0     };
+// for when the board is replaced (boardsize, clear_board, loading a game)
+void treeReset(search_tree_t *const tree)
+{
+	mctsFree(&tree->root);
 
-	bool pass[2] { false };
+	tree->key    = 0;
+	tree->player = P_BLACK;
+	tree->dim    = 0;
+}
 
-	while(++mc < dim * dim * dim) {
-		std::vector<Vertex> liberties;
-		findLiberties(cm, &liberties, playerToStone(p));
+// starts over unless the tree is for this position
+void treePrepare(search_tree_t *const tree, const Board & b, const player_t p)
+{
+	if (tree->key != b.getKey() || tree->player != p || tree->dim != b.getDim()) {
+		mctsFree(&tree->root);
 
-		// no valid liberties? return "pass".
-		if (liberties.empty()) {
-			pass[p] = true;
+		tree->key    = b.getKey();
+		tree->player = p;
+		tree->dim    = b.getDim();
+	}
+}
 
-			if (pass[0] && pass[1])
-				break;
+// follows a move (or MCTS_PASS) by "p" that was played on "b"
+// "keyBefore" is the key of the position it was played in
+void treeFollow(search_tree_t *const tree, const uint64_t keyBefore, const player_t p, const point_t move, const Board & b)
+{
+	if (tree->key != keyBefore || tree->player != p || tree->dim != b.getDim() || mctsAdvance(&tree->root, move) == false)
+		mctsFree(&tree->root);
 
-			p = getOpponent(p);
+	tree->key    = b.getKey();
+	tree->player = getOpponent(p);
+	tree->dim    = b.getDim();
+}
 
-			continue;
-		}
+// searching on the opponent's time: from after our genmove until the next command
+typedef struct {
+	Deadline   *stop   { nullptr };  // nullptr when not pondering
+	ThreadPool *pool   { nullptr };
+	uint32_t    visits { 0       };  // in the tree when pondering started
+} ponder_t;
 
-		pass[0] = pass[1] = false;
+// "b" may not change until stopPonder()
+void startPonder(ponder_t *const pd, search_tree_t *const tree, const Board & b, const player_t p, const double komi, ThreadPool *const pool)
+{
+	treePrepare(tree, b, p);
 
-		size_t r  = 0;
+	pd->stop   = new Deadline(UINT64_MAX);
+	pd->pool   = pool;
+	pd->visits = tree->root.visits;
 
-		size_t chainSize = liberties.size();
+	mctsStart(&tree->root, b, p, komi, pool, pd->stop);
+}
 
-		std::uniform_int_distribution<> rng(0, chainSize);
-		r = rng(gen);
+void stopPonder(ponder_t *const pd, const search_tree_t & tree)
+{
+	if (pd->stop == nullptr)
+		return;
 
-		if (r < chainSize) {  // pass
-			const int x = liberties.at(r).getX();
-			const int y = liberties.at(r).getY();
+	pd->stop->cancel();
 
-			connect(&b, &cm, &chainsWhite, &chainsBlack, playerToStone(p), x, y);
+	pd->pool->wait();
 
-			uint64_t new_hash = b.getHash();
+	delete pd->stop;
+	pd->stop = nullptr;
 
-			if (seen.insert(new_hash).second == false)  // terminate loop if already in the set
-				break;
-		}
+	send(true, "# pondered %u playouts", tree.root.visits - pd->visits);
+}
 
-		p = getOpponent(p);
-	}
+// how often (ms) selectMCTS() looks at the root while the search runs
+constexpr int MCTS_CHECK_INTERVAL = 10;
 
-	purgeChains(&chainsBlack);
-	purgeChains(&chainsWhite);
+void selectMCTS(const Board & b, const ChainMap & cm, const std::vector<chain_t *> & chainsWhite, const std::vector<chain_t *> & chainsBlack, const std::vector<point_t> & liberties, const player_t & p, std::vector<eval_t> *const evals, const time_budget_t & budget, const uint64_t start_t, const double komi, ThreadPool *const pool, search_tree_t *const tree, const Deadline *const hardStop)
+{
+	uint64_t target_t = start_t + budget.target * 900;
+	uint64_t end_t    = start_t + budget.limit  * 900;
 
-	auto s = score(b, komi);
+	const int dim = b.getDim();
 
-	return std::tuple<double, double, int>(s.first, s.second, mc);
-}
+	treePrepare(tree, b, p);
 
-void playoutThread(std::vector<std::pair<double, uint32_t> > *const all_results, std::mutex *const all_results_lock, const uint64_t h_end_t, const uint64_t end_t, const std::vector<Vertex> *const liberties, const player_t p, const double komi, const Board *const b)
-{
-	const int dim   = b->getDim();
-	const int dimsq = dim * dim;
+	mcts_node_t & root = tree->root;
 
-	const player_t opponent = getOpponent(p);
+	const uint32_t reused = root.visits;
 
-	bool   halfway_trigger = false;
-	double score_threshold = -1000.;
+	Deadline stop(end_t, hardStop);
 
-	std::vector<std::pair<double, uint32_t> > local_results;
-	local_results.resize(dimsq);
+	mctsStart(&root, b, p, komi, pool, &stop);
 
-	auto lib_it = liberties->begin();
+	// watch the root: stop when the most visited move can no longer be
+	// overtaken, go on (up to end_t) when it just changed or is about tied
+	const mcts_node_t *prev_best   = nullptr;
+	uint64_t           last_change = start_t;
 
 	for(;;) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(MCTS_CHECK_INTERVAL));
+
 		uint64_t now = get_ts_ms();
 
-		if (now >= end_t)
+		if (now >= end_t || stop.isCancelled())
 			break;
 
-		if (now >= h_end_t && halfway_trigger == false) {
-			halfway_trigger = true;
+		if (root.state.load(std::memory_order_acquire) != MCTS_EXPANDED)
+			continue;
 
-			double total_scores = 0.;
-			int    total_count  = 0;
+		const mcts_node_t *best   = nullptr;
+		uint32_t           second = 0;
 
-			for(int i=0; i<dimsq; i++) {
-				total_scores += local_results.at(i).first;
-				total_count  += local_results.at(i).second;
-			}
+		for(int i=0; i<root.nChildren; i++) {
+			const mcts_node_t *cur = &root.children[i];
 
-			score_threshold = total_scores / total_count;
+			if (best == nullptr || cur->visits > best->visits) {
+				if (best)
+					second = best->visits;
 
-			// printf("set threshold to %f\n", score_threshold);
+				best = cur;
+			}
+			else if (cur->visits > second) {
+				second = cur->visits;
+			}
 		}
 
-		int    v             = lib_it->getV();
+		if (best != prev_best) {
+			prev_best   = best;
+			last_change = now;
 
-		// when never played, try get it played
-		double current_score = local_results.at(v).second > 0 ? local_results.at(v).first / local_results.at(v).second : 1000000.;
+			searchBest  = best->move == MCTS_PASS ? -1 : best->move;
+		}
 
-		if (current_score >= score_threshold) {
-			Board work(*b);
+		const uint32_t lead = best->visits - std::min(second, best->visits.load());
 
-			play(&work, *lib_it, p);
+		// playouts still to come at the current rate
+		const double rate = double(root.visits - reused) / std::max(uint64_t(1), now - start_t);
 
-			auto rc = playout(work, komi, opponent);
+		if (now < target_t) {
+			const double remaining = rate * (target_t - now);
 
-			double score = p == P_BLACK ? std::get<0>(rc) - std::get<1>(rc) : std::get<1>(rc) - std::get<0>(rc);
+			if (root.nChildren == 1 || (now - start_t >= budget.target * 100 && lead > remaining)) {
+				send(true, "# mcts: best move can no longer be overtaken (lead %u, %.0f playouts to go), stopping after %.3fs", lead, remaining, (now - start_t) / 1000.);
 
-			local_results.at(v).first += score;
-			local_results.at(v).second++;
+				break;
+			}
 		}
+		else {
+			const bool recent = now - last_change < (now - start_t) / 4;
+			const bool tied   = second >= best->visits * 0.9;
 
-		lib_it++;
-
-		if (lib_it == liberties->end())
-			lib_it = liberties->begin();
-	}
-
-	std::unique_lock<std::mutex> lck(*all_results_lock);
-
-	for(int i=0; i<dimsq; i++) {
-		if (local_results.at(i).second) {
-			all_results->at(i).first  += local_results.at(i).first;  // score
-			all_results->at(i).second += local_results.at(i).second;  // count
+			if ((recent == false && tied == false) || lead > rate * (end_t - now))
+				break;
 		}
 	}
-}
 
-void selectPlayout(const Board & b, const ChainMap & cm, const std::vector<chain_t *> & chainsWhite, const std::vector<chain_t *> & chainsBlack, const std::vector<Vertex> & liberties, const player_t & p, std::vector<eval_t> *const evals, const double useTime, const double komi, const int nThreads)
-{
-	uint64_t start_t = get_ts_ms();  // TODO: start of genMove()
-	uint64_t h_end_t = start_t + useTime * 450;
-	uint64_t end_t   = start_t + useTime * 900;
-
-	std::vector<std::thread *> threads;
-
-	const int dim   = b.getDim();
-	const int dimsq = dim * dim;
-
-	std::vector<std::pair<double, uint32_t> > all_results;
-	all_results.resize(dimsq);
-
-	std::mutex all_results_lock;
+	if (get_ts_ms() > target_t + MCTS_CHECK_INTERVAL)
+		send(true, "# mcts: best move not settled, extended search by %.3fs", (get_ts_ms() - target_t) / 1000.);
 
-	for(int i=0; i<nThreads; i++)
-		threads.push_back(new std::thread(playoutThread, &all_results, &all_results_lock, h_end_t, end_t, &liberties, p, komi, &b));
+	stop.cancel();
 
-	while(threads.empty() == false) {
-		(*threads.begin())->join();
+	pool->wait();
 
-		delete *threads.begin();
+	for(int i=0; i<root.nChildren; i++) {
+		const mcts_node_t & child = root.children[i];
 
-		threads.erase(threads.begin());
-	}
-
-	for(int i=0; i<dimsq; i++) {
-		if (all_results.at(i).second) {
-			double score = all_results.at(i).first / all_results.at(i).second;
-
-			evals->at(i).score += score;
+		if (child.move != MCTS_PASS && child.visits) {
+			evals->at(child.move).score += child.visits;
 
-			evals->at(i).valid = true;
+			evals->at(child.move).valid = true;
 		}
 	}
-}
 
-void purgeKO(const Board & b, const player_t p, std::set<uint64_t> *const seen, std::vector<Vertex> *const liberties)
-{
-	for(auto it = liberties->begin(); it != liberties->end();) {
-		Board temp(b);
+	const mcts_node_t *best = mctsBestChild(root);
 
-		play(&temp, *it, p);
+	if (best && best->visits) {
+		std::string pv;
 
-		if (seen->find(temp.getHash()) != seen->end())
-			it = liberties->erase(it);
-		else
-			it++;
+		for(auto move : mctsGetPv(root))
+			pv += " " + (move == MCTS_PASS ? std::string("pass") : v2t(Vertex(move, dim)));
+
+		send(true, "# mcts: %u playouts in %.3fs (%u reused), best: %u visits, win rate %.3f, pv:%s", root.visits - reused, (get_ts_ms() - start_t) / 1000., reused, best->visits.load(), best->wins2 / (2. * best->visits), pv.c_str());
 	}
 }
 
-std::optional<Vertex> genMove(Board *const b, const player_t & p, const bool doPlay, const double useTime, const double komi, const int nThreads, std::set<uint64_t> *const seen)
+// "budget" counts from "start_t" (ms, see get_ts_ms()): when the move was asked for
+std::optional<Vertex> genMove(Board *const b, const player_t & p, const bool doPlay, const time_budget_t & budget, const uint64_t start_t, const double komi, ThreadPool *const pool, search_tree_t *const tree, TranspositionTable *const tt, const Deadline *const hardStop)
 {
 	dump(*b);
 
-	if (useTime <= 0.001)
-		return { };
-
 	const int dim = b->getDim();
 	const int p2dim = dim * dim;
 
@@ -660,17 +503,17 @@ std::optional<Vertex> genMove(Board *const b, const player_t & p, const bool doP
 	std::vector<chain_t *> chainsWhite, chainsBlack;
 	findChains(*b, &chainsWhite, &chainsBlack, &cm);
 
-	std::vector<Vertex> liberties;
-	findLiberties(cm, &liberties, playerToStone(p));
+	move_list_t moves;
+	b->generateMoves(playerToStone(p), &moves);
+
+	std::vector<point_t> liberties(moves.moves, moves.moves + moves.n);
 
 	dump(cm);
 
 	dump(chainsBlack);
 	dump(chainsWhite);
 
-	dump(liberties);
-	purgeKO(*b, p, seen, &liberties);
-	dump(liberties);
+	dump(liberties, dim);
 
 	// no valid liberties? return "pass".
 	if (liberties.empty()) {
@@ -680,16 +523,16 @@ std::optional<Vertex> genMove(Board *const b, const player_t & p, const bool doP
 		return { };
 	}
 
-	send(true, "# useTime: %f", useTime);
+	send(true, "# useTime: %f (at most %f)", budget.target, budget.limit);
 
 	std::vector<eval_t> evals;
 	evals.resize(p2dim);
 
-	if (useTime >= 0.1)
-		// selectAlphaBeta(*b, cm, chainsWhite, chainsBlack, liberties, p, &evals, useTime, komi, nThreads);
-		selectPlayout(*b, cm, chainsWhite, chainsBlack, liberties, p, &evals, useTime, komi, nThreads);
+	if (budget.target >= 0.1)
+		// selectAlphaBeta(*b, cm, chainsWhite, chainsBlack, liberties, p, &evals, budget, start_t, komi, pool, tt, hardStop);
+		selectMCTS(*b, cm, chainsWhite, chainsBlack, liberties, p, &evals, budget, start_t, komi, pool, tree, hardStop);
 	else {
-		scanEnclosed(*b, &cm, playerToStone(p));
+		findRegions(*b, &cm, playerToStone(p));
 
 		selectRandom(*b, cm, chainsWhite, chainsBlack, liberties, p, &evals);
 
@@ -708,7 +551,7 @@ std::optional<Vertex> genMove(Board *const b, const player_t & p, const bool doP
 		if (evals.at(i).score > bestScore && evals.at(i).valid) {
 			Vertex temp { i, dim };
 
-			if (std::find(liberties.begin(), liberties.end(), temp) == liberties.end())
+			if (std::find(liberties.begin(), liberties.end(), i) == liberties.end())
 				send(true, "# invalid move %s detected", v2t(temp).c_str());
 			else {
 				bestScore = evals.at(i).score;
@@ -746,8 +589,13 @@ std::optional<Vertex> genMove(Board *const b, const player_t & p, const bool doP
 
 	// remove any chains that no longer have liberties after this move
 	// also play the move
-	if (doPlay && v.has_value())
-		play(b, v.value(), p);
+	if (doPlay && v.has_value()) {
+		const uint64_t keyBefore = b->getKey();
+
+		play(b, v.value().getV(), p);
+
+		treeFollow(tree, keyBefore, p, v.value().getV(), *b);
+	}
 
 	purgeChains(&chainsBlack);
 	purgeChains(&chainsWhite);
@@ -764,10 +612,16 @@ double benchmark_1(const Board & in, const unsigned ms, const double komi)
 	uint64_t n     = 0;
 	uint64_t total_puts = 0;
 
+	PlayoutEngine engine(in);
+
+#ifdef COUNT_ALLOCS
+	uint64_t start_allocs = getAllocationCount();
+#endif
+
 	do {
-		auto result = playout(in, komi, P_BLACK);
+		auto result = engine.playout(in, komi, P_BLACK, nullptr);
 
-		total_puts += std::get<2>(result);
+		total_puts += std::get<2>(result.value());
 
 		n++;
 
@@ -778,6 +632,9 @@ double benchmark_1(const Board & in, const unsigned ms, const double komi)
 	double td         = (end - start) / 1000.;
 	double n_playouts = n / td;
 	send(true, "# playouts (total: %lu) per second: %f (%.1f stones on average (total: %lu) or %f stones per second)", n, n_playouts, total_puts / double(n), total_puts, total_puts / td);
+#ifdef COUNT_ALLOCS
+	send(true, "# heap allocations per playout: %.1f", (getAllocationCount() - start_allocs) / double(n));
+#endif
 
 	return n_playouts;
 }
@@ -824,9 +681,7 @@ double benchmark_3(const Board & in, const unsigned ms)
 
 	uint64_t end_ts = start + ms;
 
-	std::atomic_bool quick_stop { false };
-
-	end_indicator_t  ei { false };
+	Deadline stop(end_ts);
 
 	srand(101);
 
@@ -838,7 +693,7 @@ double benchmark_3(const Board & in, const unsigned ms)
 		for(int i=0; i<nstones; i++)
 			work.setAt(rand() % dimsq, rand() & 1 ? B_WHITE : B_BLACK);
 
-		search(work, P_BLACK, -32767, 32767, 4, 1.5, end_ts, &ei, &quick_stop);
+		search(&work, P_BLACK, -32767, 32767, 4, 1.5, stop);
 
 		n++;
 
@@ -852,6 +707,162 @@ double benchmark_3(const Board & in, const unsigned ms)
 	return pops;
 }
 
+double benchmark_4(const Board & in, const unsigned ms)
+{
+	send(true, "# starting benchmark 4: duration: %.3fs, board dimensions: %d", ms / 1000.0, in.getDim());
+
+	int      dim    = in.getDim();
+	int      dimsq  = dim * dim;
+
+	srand(101);
+
+	// random positions, about as full as at the end of a playout
+	std::vector<Board *> positions;
+
+	for(int i=0; i<64; i++) {
+		Board *work = new Board(&z, dim);
+
+		for(int j=0; j<dimsq * 3 / 4; j++)
+			work->setAt(rand() % dimsq, rand() & 1 ? B_WHITE : B_BLACK);
+
+		positions.push_back(work);
+	}
+
+	uint64_t start  = get_ts_ms();
+	uint64_t end    = 0;
+	uint64_t n      = 0;
+	double   total  = 0.;
+
+	do {
+		for(int i=0; i<1000; i++) {
+			auto s = score(*positions.at(n & 63), 0.);
+
+			total += s.first - s.second;
+
+			n++;
+		}
+
+		end = get_ts_ms();
+	}
+	while(end - start < ms);
+
+	for(auto p : positions)
+		delete p;
+
+	double sps = n * 1000. / (end - start);
+	send(true, "# scores (%lu total) per second: %f, %.1f ns per score (%f)", n, sps, 1000000000. / sps, total);
+
+	return sps;
+}
+
+// alpha-beta on all threads, iterative deepening on the current position
+double benchmark_5(const Board & in, const unsigned ms, const double komi, ThreadPool *const pool, TranspositionTable *const tt)
+{
+	send(true, "# starting benchmark 5: duration: %.3fs, board dimensions: %d, threads: %d", ms / 1000.0, in.getDim(), pool->getN());
+
+	const player_t p = in.getToMove() == B_BLACK ? P_BLACK : P_WHITE;
+
+	move_list_t rootMoves;
+	in.generateMoves(in.getToMove(), &rootMoves);
+
+	uint64_t start  = get_ts_ms();
+	uint64_t n      = 0;
+	int      depth  = 1;
+
+	Deadline stop(start + ms);
+
+	tt->clear();
+
+	ordering_t ordering;
+	orderingClear(&ordering);
+
+	std::optional<int> previous_score;
+
+	while(stop.isStopped() == false && depth <= in.getDim() * in.getDim()) {
+		auto result = searchAspiration(in, p, depth, previous_score, komi, rootMoves, pool, tt, &ordering, stop);
+
+		n += result.nodes;
+
+		if (result.completed) {
+			previous_score = result.score;
+
+			depth++;
+		}
+	}
+
+	uint64_t end = get_ts_ms();
+
+	double nps = n * 1000. / (end - start);
+	send(true, "# nodes (%lu total) per second: %f, reached depth: %d", n, nps, depth);
+
+	return nps;
+}
+
+// items per second through a queue of type Q, "n" producers and "n" consumers
+template <typename Q>
+double benchmark_queue(const unsigned ms, const int n)
+{
+	Q queue(256);
+
+	std::atomic_bool     stop     { false };
+	std::atomic_uint64_t consumed { 0     };
+
+	std::vector<std::thread> threads;
+
+	for(int i=0; i<n; i++) {
+		threads.emplace_back([&queue, &stop] {
+				int v = 0;
+
+				while(!stop) {
+					if (!queue.try_put(v))
+						std::this_thread::yield();
+					else
+						v++;
+				}
+			});
+
+		threads.emplace_back([&queue, &stop, &consumed] {
+				uint64_t local = 0;
+
+				while(!stop) {
+					if (queue.get(10).has_value())
+						local++;
+				}
+
+				consumed += local;
+			});
+	}
+
+	uint64_t start = get_ts_ms();
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+
+	stop = true;
+
+	for(auto & t : threads)
+		t.join();
+
+	uint64_t end = get_ts_ms();
+
+	return consumed * 1000. / (end - start);
+}
+
+// the mutex-based fifo against the lock-free one, contended
+double benchmark_6(const unsigned ms, const int nThreads)
+{
+	const int n = std::max(2, nThreads);
+
+	send(true, "# starting benchmark 6: duration: %.3fs, producers/consumers: %d", ms / 1000.0, n);
+
+	double fps = benchmark_queue<fifo<int> >(ms / 2, n);
+	send(true, "# fifo: %f items per second", fps);
+
+	double lps = benchmark_queue<lfqueue<int> >(ms / 2, n);
+	send(true, "# lfqueue: %f items per second (%.2fx)", lps, lps / fps);
+
+	return lps;
+}
+
 void load_stones(Board *const b, const char *in, const board_t & bv)
 {
 	while(in[0] == '[') {
@@ -974,32 +985,33 @@ Board loadSgf(const std::string & in)
 	return b;
 }
 
-int getNEmpty(const Board & b, const player_t p)
+int getNLegal(const Board & b, const player_t p)
 {
-	ChainMap cm(b.getDim());
+	move_list_t moves;
+	b.generateMoves(playerToStone(p), &moves);
 
-	std::vector<chain_t *> chainsWhite, chainsBlack;
-	findChains(b, &chainsWhite, &chainsBlack, &cm);
-
-	std::vector<Vertex> liberties;
-	findLiberties(cm, &liberties, playerToStone(p));
-
-	purgeChains(&chainsBlack);
-	purgeChains(&chainsWhite);
-
-	return liberties.size();
+	return moves.n;
 }
 
 int main(int argc, char *argv[])
 {
 	int nThreads = std::thread::hardware_concurrency();
 
+	bool doPonder = false;
+
+	int ttMB = 64;
+
+	// genmove is answered at most this long (ms) after the time limit of the move
+	int watchdogSlack = 200;
+
+	double safetyMargin = 0.25;
+
 	int dim = 9;
 
 	std::string logfile;
 
 	int c = -1;
-	while((c = getopt(argc, argv, "l:vt:5")) != -1) {
+	while((c = getopt(argc, argv, "l:vt:5PT:m:w:")) != -1) {
 		if (c == 'v')  // console
 			setVerbose(true);
 		else if (c == 't')
@@ -1008,6 +1020,14 @@ int main(int argc, char *argv[])
 			dim = 5;
 		else if (c == 'l')
 			logfile = optarg;
+		else if (c == 'P')
+			doPonder = true;
+		else if (c == 'T')  // transposition table size in MB
+			ttMB = atoi(optarg);
+		else if (c == 'm')  // kept off the time of each move, in ms
+			safetyMargin = atoi(optarg) / 1000.;
+		else if (c == 'w')
+			watchdogSlack = atoi(optarg);
 	}
 
 	if (logfile.empty() == false)
@@ -1024,23 +1044,34 @@ int main(int argc, char *argv[])
 	
 	int      pass = 0;
 
-	double timeLeftB = -1;
-	double timeLeftW = -1;
+	TimeManager tm(safetyMargin);
 
 	double komi = 0.;
 
-	int moves_executed = 0;
-	int moves_total    = dim * dim;
-
 	std::string sgf = init_sgf(b->getDim());
 
-	std::set<uint64_t> seen;
+	// started once, used by all searches
+	ThreadPool pool(std::max(1, nThreads));
+
+	TranspositionTable tt(std::max(1, ttMB));
+
+	Watchdog watchdog;
+
+	ponder_t ponder;
 
 	for(;;) {
 		char buffer[4096] { 0 };
-		if (!fgets(buffer, sizeof buffer, stdin))
+		char *line = fgets(buffer, sizeof buffer, stdin);
+
+		// whatever the command is, the board may change
+		stopPonder(&ponder, searchTree);
+
+		if (!line)
 			break;
 
+		bool ponderAfter = false;
+		bool responded   = false;  // the response was already sent completely
+
 		char *cr = strchr(buffer, '\r');
 		if (cr)
 			*cr = 0x00;
@@ -1069,10 +1100,21 @@ int main(int argc, char *argv[])
 		else if (parts.at(0) == "version")
 			send(false, "=%s 0.1", id.c_str());
 		else if (parts.at(0) == "boardsize" && parts.size() == 2) {
-			delete b;
-			b = new Board(&z, atoi(parts.at(1).c_str()));
+			int new_dim = atoi(parts.at(1).c_str());
 
-			send(false, "=%s", id.c_str());
+			if (new_dim < 1 || new_dim > MAX_DIM || (new_dim & 1) == 0)
+				send(false, "?%s unacceptable size", id.c_str());
+			else {
+				delete b;
+				b = new Board(&z, new_dim);
+
+				// neither the search tree nor the transposition table can tell
+				// positions of different board sizes apart by their key
+				treeReset(&searchTree);
+				tt.clear();
+
+				send(false, "=%s", id.c_str());
+			}
 		}
 		else if (parts.at(0) == "clear_board") {
 			int dim = b->getDim();
@@ -1080,19 +1122,15 @@ int main(int argc, char *argv[])
 			delete b;
 			b = new Board(&z, dim);
 
-			seen.clear();
+			treeReset(&searchTree);
+			tt.clear();
 
 			p    = P_BLACK;
 			pass = 0;
 
 			send(false, "=%s", id.c_str());
 
-			moves_executed = 0;
-			// not /2: assuming that some stones are regained during the game
-			moves_total    = dim * dim;
-
-			timeLeftW      = -1;
-			timeLeftB      = -1;
+			tm.newGame();
 
 			sgf = init_sgf(dim);
 		}
@@ -1101,12 +1139,21 @@ int main(int argc, char *argv[])
 
 			send(false, "=%s", id.c_str());
 
-			if (str_tolower(parts.at(2)) == "pass")
+			const uint64_t keyBefore = b->getKey();
+
+			if (str_tolower(parts.at(2)) == "pass") {
+				b->pass();
+
+				treeFollow(&searchTree, keyBefore, p, MCTS_PASS, *b);
+
 				pass++;
+			}
 			else {
 				Vertex v = t2v(parts.at(2), b->getDim());
 
-				play(b, v, p);
+				play(b, v.getV(), p);
+
+				treeFollow(&searchTree, keyBefore, p, v.getV(), *b);
 
 				pass = 0;
 			}
@@ -1115,8 +1162,6 @@ int main(int argc, char *argv[])
 
 			send(true, "# %s)", sgf.c_str());
 
-			seen.insert(b->getHash());
-
 			p = getOpponent(p);
 
 			send(true, "# %s", dumpToString(*b, p, 0).c_str());
@@ -1135,15 +1180,15 @@ int main(int argc, char *argv[])
 
 				send(true, "%c", p == P_BLACK ? 'B' : 'W');
 
-				scanEnclosed(*b, &cm, s);
+				findRegions(*b, &cm, s);
 
 				dump(chainsBlack);
 				dump(chainsWhite);
 				dump(cm);
 
-				std::vector<Vertex> liberties;
+				std::vector<point_t> liberties;
 				findLiberties(cm, &liberties, s);
-				dump(liberties);
+				dump(liberties, b->getDim());
 
 				purgeChains(&chainsBlack);
 				purgeChains(&chainsWhite);
@@ -1169,6 +1214,12 @@ int main(int argc, char *argv[])
 				pops = benchmark_2(*b, atoi(parts.at(1).c_str()));
 			else if (parts.at(2) == "3")
 				pops = benchmark_3(*b, atoi(parts.at(1).c_str()));
+			else if (parts.at(2) == "4")
+				pops = benchmark_4(*b, atoi(parts.at(1).c_str()));
+			else if (parts.at(2) == "5")
+				pops = benchmark_5(*b, atoi(parts.at(1).c_str()), komi, &pool, &tt);
+			else if (parts.at(2) == "6")
+				pops = benchmark_6(atoi(parts.at(1).c_str()), pool.getN());
 
 			send(false, "=%s %f", id.c_str(), pops);
 		}
@@ -1179,18 +1230,51 @@ int main(int argc, char *argv[])
 							//
 			sgf += "KM[" + parts.at(1) + "]";
 		}
-		else if (parts.at(0) == "time_settings") {
-			send(false, "=%s", id.c_str());  // TODO
+		else if (parts.at(0) == "time_settings" && parts.size() == 4) {
+			double main_time  = atof(parts.at(1).c_str());
+			double byo_time   = atof(parts.at(2).c_str());
+			int    byo_stones = atoi(parts.at(3).c_str());
+
+			if (byo_time > 0 && byo_stones == 0)  // no time limit
+				tm.setSettings(TC_NONE, 0., 0., 0);
+			else if (byo_time <= 0)
+				tm.setSettings(TC_ABSOLUTE, main_time, 0., 0);
+			else
+				tm.setSettings(TC_CANADIAN, main_time, byo_time, byo_stones);
+
+			send(true, "# time: %s", tm.toString(P_BLACK).c_str());
+
+			send(false, "=%s", id.c_str());
+		}
+		else if (parts.at(0) == "kgs-time_settings" && parts.size() >= 2) {
+			bool ok = true;
+
+			if (parts.at(1) == "none")
+				tm.setSettings(TC_NONE, 0., 0., 0);
+			else if (parts.at(1) == "absolute" && parts.size() == 3)
+				tm.setSettings(TC_ABSOLUTE, atof(parts.at(2).c_str()), 0., 0);
+			else if (parts.at(1) == "byoyomi" && parts.size() == 5)
+				tm.setSettings(TC_JAPANESE, atof(parts.at(2).c_str()), atof(parts.at(3).c_str()), atoi(parts.at(4).c_str()));
+			else if (parts.at(1) == "canadian" && parts.size() == 5)
+				tm.setSettings(TC_CANADIAN, atof(parts.at(2).c_str()), atof(parts.at(3).c_str()), atoi(parts.at(4).c_str()));
+			else
+				ok = false;
+
+			if (ok) {
+				send(true, "# time: %s", tm.toString(P_BLACK).c_str());
+
+				send(false, "=%s", id.c_str());
+			}
+			else {
+				send(false, "?%s syntax error", id.c_str());
+			}
 		}
 		else if (parts.at(0) == "time_left" && parts.size() >= 3) {
 			player_t player = (parts.at(1) == "b" || parts.at(1) == "black") ? P_BLACK : P_WHITE;
 
-			if (player == P_BLACK)
-				timeLeftB = atof(parts.at(2).c_str());
-			else
-				timeLeftW = atof(parts.at(2).c_str());
+			tm.setTimeLeft(player, atof(parts.at(2).c_str()), parts.size() >= 4 ? atoi(parts.at(3).c_str()) : 0);
 
-			send(false, "=%s", id.c_str());  // TODO
+			send(false, "=%s", id.c_str());
 		}
 		else if (parts.at(0) == "list_commands") {
 			send(false, "=%s name", id.c_str());
@@ -1204,6 +1288,7 @@ int main(int argc, char *argv[])
 			send(false, "loadsgf");
 			send(false, "final_score");
 			send(false, "time_settings");
+			send(false, "kgs-time_settings");
 			send(false, "time_left");
 		}
 		else if (parts.at(0) == "final_score") {
@@ -1220,8 +1305,8 @@ int main(int argc, char *argv[])
 			delete b;
 			b = new Board(loadSgfFile(parts.at(1)));
 
-			seen.clear();
-			seen.insert(b->getHash());
+			treeReset(&searchTree);
+			tt.clear();
 
 			p    = P_BLACK;
 			pass = 0;
@@ -1232,8 +1317,8 @@ int main(int argc, char *argv[])
 			delete b;
 			b = new Board(loadSgf(parts.at(1)));
 
-			seen.clear();
-			seen.insert(b->getHash());
+			treeReset(&searchTree);
+			tt.clear();
 
 			p    = P_BLACK;
 			pass = 0;
@@ -1243,7 +1328,9 @@ int main(int argc, char *argv[])
 		else if (parts.at(0) == "autoplay" && parts.size() == 2) {
 			double think_time = atof(parts.at(1).c_str());
 
-			double time_left[] = { think_time, think_time };
+			// each side "think_time" seconds for the whole game
+			TimeManager atm(0.);
+			atm.setSettings(TC_ABSOLUTE, think_time, 0., 0);
 
 			uint64_t g_start_ts = get_ts_ms();
 			int n_moves = 0;
@@ -1253,32 +1340,27 @@ int main(int argc, char *argv[])
 
 				uint64_t start_ts = get_ts_ms();
 
-				double time_use = time_left[p] / (moves_total - moves_executed);
-
-				if (++moves_executed >= moves_total)
-					moves_total = (moves_total * 4) / 3;
+				time_budget_t time_use = atm.allocate(p, *b, getNLegal(*b, p));
 
-				auto v = genMove(b, p, true, time_use, komi, nThreads, &seen);
+				auto v = genMove(b, p, true, time_use, start_ts, komi, &pool, &searchTree, &tt, nullptr);
 
 				uint64_t end_ts = get_ts_ms();
 
-				time_left[p] -= (end_ts - start_ts) / 1000.;
+				atm.moveDone(p, (end_ts - start_ts) / 1000.);
 
 				const char *color = p == P_BLACK ? "black" : "white";
 
-				if (time_left[p] < 0)
-					send(true, "# %s is out of time (%f)", color, time_left[p]);
+				if (atm.getTimeLeft(p) < 0)
+					send(true, "# %s is out of time (%f)", color, atm.getTimeLeft(p));
 
 				if (v.has_value() == false)
 					break;
 
 				double took = (end_ts - start_ts) / 1000.;
 
-				send(true, "# %s (%s), time allocated: %.3f, took %.3fs (%.2f%%), move-nr: %d, time left: %.3f", v2t(v.value()).c_str(), color, time_use, took, took * 100 / time_use, n_moves, time_left[p]);
+				send(true, "# %s (%s), time allocated: %.3f, took %.3fs (%.2f%%), move-nr: %d, time left: %.3f", v2t(v.value()).c_str(), color, time_use.target, took, took * 100 / time_use.target, n_moves, atm.getTimeLeft(p));
 
 				p = getOpponent(p);
-
-				seen.insert(b->getHash());
 			}
 
 			uint64_t g_end_ts = get_ts_ms();
@@ -1288,43 +1370,113 @@ int main(int argc, char *argv[])
 		else if (parts.at(0) == "genmove" || parts.at(0) == "reg_genmove") {
 			player_t player = (parts.at(1) == "b" || parts.at(1) == "black") ? P_BLACK : P_WHITE;
 
-			double timeLeft = player == P_BLACK ? timeLeftB : timeLeftW;
-
-			if (timeLeft < 0)
-				timeLeft = 5.0;
+			time_budget_t time_use = tm.allocate(player, *b, getNLegal(*b, player));
 
-			double time_use = timeLeft / (std::max(getNEmpty(*b, player), moves_total) - moves_executed);
+			send(true, "# time: %s, allocated: %.3fs (at most %.3fs)", tm.toString(player).c_str(), time_use.target, time_use.limit);
 
-			if (++moves_executed >= moves_total)
-				moves_total = (moves_total * 4) / 3;
+			const bool doPlay = parts.at(0) == "genmove";
 
 			uint64_t start_ts = get_ts_ms();
-			auto v = genMove(b, player, parts.at(0) == "genmove", time_use, komi, nThreads, &seen);
+
+			// when the search does not return in time, the watchdog stops it
+			// and sends the (complete) response itself: the best move so far or
+			// else what the fast heuristics say for the position of before the
+			// search (the search may be playing its move on "b")
+			Deadline hardStop(UINT64_MAX);
+
+			const Board before(*b);
+
+			std::optional<Vertex> answered;
+
+			const int      dim     = b->getDim();
+			const uint64_t hard_ts = std::max(double(start_ts), start_ts + time_use.limit * 1000 + watchdogSlack);
+
+			searchBest = -1;
+
+			watchdog.arm(hard_ts, [&] {
+					hardStop.cancel();
+
+					const int best = searchBest;
+
+					if (best >= 0)
+						answered = Vertex(best, dim);
+					else {
+						Board work(before);
+
+						answered = genMove(&work, player, false, { 0.05, 0.05 }, get_ts_ms(), komi, &pool, &searchTree, &tt, nullptr);
+					}
+
+					send(false, "=%s %s", id.c_str(), answered.has_value() ? v2t(answered.value()).c_str() : "pass");
+					send(false, "");
+
+					fflush(nullptr);
+
+					send(true, "# watchdog: no move after %lu ms, answered %s (%s)", get_ts_ms() - start_ts, answered.has_value() ? v2t(answered.value()).c_str() : "pass", best >= 0 ? "best so far" : "heuristics");
+				});
+
+			auto v = genMove(b, player, doPlay, time_use, start_ts, komi, &pool, &searchTree, &tt, &hardStop);
+
+			const bool answeredByWatchdog = watchdog.disarm();
+
+			responded = answeredByWatchdog;
+
 			uint64_t end_ts = get_ts_ms();
 
-			timeLeft = -1.0;
+			if (end_ts > start_ts + time_use.limit * 1000)
+				send(true, "# overrun: genmove took %lu ms, %.0f ms allowed", end_ts - start_ts, time_use.limit * 1000);
+
+			// what was answered is what is played
+			if (answeredByWatchdog && answered != v) {
+				if (doPlay) {
+					if (v.has_value())
+						b->unplay();
+
+					if (answered.has_value()) {
+						const uint64_t keyBefore = b->getKey();
+
+						play(b, answered.value().getV(), player);
+
+						treeFollow(&searchTree, keyBefore, player, answered.value().getV(), *b);
+					}
+				}
+
+				v = answered;
+			}
+
+			// until the next time_left (if any)
+			tm.moveDone(player, (end_ts - start_ts) / 1000.);
 
 			if (v.has_value()) {
-				send(false, "=%s %s", id.c_str(), v2t(v.value()).c_str());
+				if (answeredByWatchdog == false)
+					send(false, "=%s %s", id.c_str(), v2t(v.value()).c_str());
 
 				sgf += myformat(";%c[%s]", player == P_BLACK ? 'B' : 'W', v2t(v.value()).c_str());
 
 				pass = 0;
 			}
 			else {
-				send(false, "=%s pass", id.c_str());
+				if (answeredByWatchdog == false)
+					send(false, "=%s pass", id.c_str());
+
+				if (doPlay) {
+					const uint64_t keyBefore = b->getKey();
+
+					b->pass();
+
+					treeFollow(&searchTree, keyBefore, player, MCTS_PASS, *b);
+				}
 
 				pass++;
 			}
 
+			ponderAfter = doPonder && parts.at(0) == "genmove";
+
 			send(true, "# %s)", sgf.c_str());
 
 			send(true, "# took %.3fs for %s", (end_ts - start_ts) / 1000.0, v.has_value() ? v2t(v.value()).c_str() : "pass");
 
 			p = getOpponent(player);
 
-			seen.insert(b->getHash());
-
 			send(true, "# %s", dumpToString(*b, p, 0).c_str());
 		}
 		else if (parts.at(0) == "cputime") {
@@ -1347,7 +1499,7 @@ int main(int argc, char *argv[])
 			int      verbose = parts.size() == 3 ? atoi(parts.at(2).c_str()) : 0;
 
 			uint64_t start_t = get_ts_ms();
-			uint64_t total   = perft(*b, &seen, p, depth, pass, verbose, true);
+			uint64_t total   = perft(b, p, depth, pass, verbose, true);
 			uint64_t diff_t  = std::max(uint64_t(1), get_ts_ms() - start_t);
 
 			send(true, "# Total perft for %c and %d passes with depth %d: %lu (%.1f moves per second, %.3f seconds)", p == P_BLACK ? 'B' : 'W', pass, depth, total, total * 1000. / diff_t, diff_t / 1000.);
@@ -1368,7 +1520,10 @@ int main(int argc, char *argv[])
 			p    = std::get<1>(new_position);
 			pass = std::get<2>(new_position);
 
-			seen.insert(b->getHash());
+			b->setState(playerToStone(p), pass);
+
+			treeReset(&searchTree);
+			tt.clear();
 
 			sgf  = dumpToSgf(*b, komi, false);
 		}
@@ -1376,11 +1531,17 @@ int main(int argc, char *argv[])
 			send(false, "?");
 		}
 
-		send(false, "");
+		if (responded == false)
+			send(false, "");
 
 		fflush(nullptr);
+
+		if (ponderAfter)
+			startPonder(&ponder, &searchTree, *b, p, komi, &pool);
 	}
 
+	mctsFree(&searchTree.root);
+
 	delete b;
 
 	closeLog();
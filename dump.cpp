@@ -1,6 +1,5 @@
 #include <set>
 #include <string>
-#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -25,17 +24,17 @@ void dump(const std::set<Vertex> & set)
 	send(true, line.c_str());
 }
 
-void dump(const std::unordered_set<Vertex, Vertex::HashFunction> & uset)
+void dump(const VertexSet & vset)
 {
 	send(true, "# Vertex set");
 
 	std::string line = "# ";
-	for(auto v : uset)
-		line += myformat("%s ", v2t(v).c_str());
+	for(auto v : vset)
+		line += myformat("%s ", v2t({ v, vset.getDim() }).c_str());
 	send(true, line.c_str());
 }
 
-void dump(const std::vector<Vertex> & vector, const bool sorted)
+void dump(const std::vector<point_t> & vector, const int dim, const bool sorted)
 {
 	send(true, "# Vertex vector");
 
@@ -47,7 +46,7 @@ void dump(const std::vector<Vertex> & vector, const bool sorted)
 	std::string line = "# ";
 
 	for(auto v : vector_sorted)
-		line += myformat("%s ", v2t(v).c_str());
+		line += myformat("%s ", v2t({ v, dim }).c_str());
 
 	send(true, line.c_str());
 }
@@ -56,9 +55,11 @@ void dump(const chain_t & chain)
 {
 	send(true, "# Chain for %s", board_t_name(chain.type));
 
+	const int dim = chain.liberties.getDim();
+
 	std::string line = "# ";
 	for(auto v : chain.chain) 
-		line += myformat("%s ", v2t(v).c_str());
+		line += myformat("%s ", v2t({ v, dim }).c_str());
 	send(true, line.c_str());
 
 	if (chain.liberties.empty() == false) {
@@ -66,7 +67,7 @@ void dump(const chain_t & chain)
 
 		line = "# ";
 		for(auto v : chain.liberties) 
-			line += myformat("%s ", v2t(v).c_str());
+			line += myformat("%s ", v2t({ v, dim }).c_str());
 		send(true, "%s", line.c_str());
 	}
 }
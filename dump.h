@@ -1,6 +1,5 @@
 #include <set>
 #include <string>
-#include <unordered_set>
 #include <vector>
 
 #include "board.h"
@@ -8,8 +7,8 @@
 
 void dump(const player_t p);
 void dump(const std::set<Vertex> & set);
-void dump(const std::unordered_set<Vertex, Vertex::HashFunction> & uset);
-void dump(const std::vector<Vertex> & vector, const bool sorted = false);
+void dump(const VertexSet & vset);
+void dump(const std::vector<point_t> & vector, const int dim, const bool sorted = false);
 void dump(const chain_t & chain);
 void dump(const std::vector<chain_t *> & chains);
 void dump(const Board & b);
@@ -115,33 +115,25 @@ bool compareChain(const std::set<Vertex> & a, const std::set<Vertex> & b)
 	return true;
 }
 
-bool compareChain(const std::unordered_set<Vertex, Vertex::HashFunction> & a, const std::unordered_set<Vertex, Vertex::HashFunction> & b)
+bool compareChain(const VertexSet & a, const VertexSet & b)
 {
-	if (a.size() != b.size())
-		return false;
-
-	for(auto v : a) {
-		if (b.find(v) == b.end())
-			return false;
-	}
-
-	return true;
+	return a == b;
 }
 
-bool compareChain(const std::unordered_set<Vertex, Vertex::HashFunction> & a, const std::set<Vertex> & b)
+bool compareChain(const VertexSet & a, const std::set<Vertex> & b)
 {
 	if (a.size() != b.size())
 		return false;
 
 	for(auto v : a) {
-		if (b.find(v) == b.end())
+		if (b.find({ v, a.getDim() }) == b.end())
 			return false;
 	}
 
 	return true;
 }
 
-bool compareChain(const std::vector<Vertex> & a, const std::vector<Vertex> & b)
+bool compareChain(const std::vector<point_t> & a, const std::vector<point_t> & b)
 {
 	if (a.size() != b.size())
 		return false;
@@ -154,7 +146,7 @@ bool compareChain(const std::vector<Vertex> & a, const std::vector<Vertex> & b)
 	return true;
 }
 
-bool findChain(const std::vector<chain_t *> & chains, const std::vector<Vertex> & search_for)
+bool findChain(const std::vector<chain_t *> & chains, const std::vector<point_t> & search_for)
 {
 	for(auto c : chains) {
 		if (compareChain(c->chain, search_for))
@@ -164,7 +156,7 @@ bool findChain(const std::vector<chain_t *> & chains, const std::vector<Vertex>
 	return false;
 }
 
-bool findChain(const std::vector<chain_t *> & chains, const std::unordered_set<Vertex, Vertex::HashFunction> & search_for)
+bool findChain(const std::vector<chain_t *> & chains, const VertexSet & search_for)
 {
 	for(auto c : chains) {
 		if (compareChain(c->liberties, search_for))
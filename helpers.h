@@ -1,6 +1,5 @@
 #include <set>
 #include <string>
-#include <unordered_set>
 #include <vector>
 
 #include "board.h"
@@ -15,11 +14,11 @@ std::tuple<Board *, player_t, int> stringToPosition(const std::string & in);
 Board stringToBoard(const std::string & in);
 std::set<Vertex> stringToChain(const std::string & in, const int dim);
 bool compareChain(const std::set<Vertex> & a, const std::set<Vertex> & b);
-bool compareChain(const std::unordered_set<Vertex, Vertex::HashFunction> & a, const std::unordered_set<Vertex, Vertex::HashFunction> & b);
-bool compareChain(const std::unordered_set<Vertex, Vertex::HashFunction> & a, const std::set<Vertex> & b);
-bool compareChain(const std::vector<Vertex> & a, const std::vector<Vertex> & b);
-bool findChain(const std::vector<chain_t *> & chains, const std::vector<Vertex> & search_for);
-bool findChain(const std::vector<chain_t *> & chains, const std::unordered_set<Vertex, Vertex::HashFunction> & search_for);
+bool compareChain(const VertexSet & a, const VertexSet & b);
+bool compareChain(const VertexSet & a, const std::set<Vertex> & b);
+bool compareChain(const std::vector<point_t> & a, const std::vector<point_t> & b);
+bool findChain(const std::vector<chain_t *> & chains, const std::vector<point_t> & search_for);
+bool findChain(const std::vector<chain_t *> & chains, const VertexSet & search_for);
 bool findChain(const std::vector<chain_t *> & chains, const std::set<Vertex> & search_for);
 bool compareChainT(const std::vector<chain_t *> & chains1, const std::vector<chain_t *> & chains2);
 std::vector<Vertex> getAdjacentVertexes(const int x, const int y, const int dim);
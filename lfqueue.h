@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <stdint.h>
+#include <thread>
+
+
+// bounded multi-producer/multi-consumer queue without locks: a ring of
+// cells that each carry a sequence number telling whether the cell can be
+// written (sequence == position) or read (sequence == position + 1) by the
+// thread that claimed that position (D. Vyukov)
+// same interface as fifo<T>; waiting is done by spinning, then sleeping
+template <typename T>
+class lfqueue
+{
+private:
+	typedef struct {
+		std::atomic_uint64_t sequence { 0 };
+		T                    data;
+	} cell_t;
+
+	cell_t        *cells       { nullptr };
+	uint64_t       mask        { 0       };
+
+	// on their own cache line so that producers and consumers do not contend
+	alignas(64) std::atomic_uint64_t enqueue_pos { 0 };
+	alignas(64) std::atomic_uint64_t dequeue_pos { 0 };
+
+	alignas(64) std::atomic_bool interrupted { false };
+
+	static void backoff(int *const n)
+	{
+		if (++*n < 64)
+			std::this_thread::yield();
+		else
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+
+public:
+	// n_elements is rounded up to a power of 2
+	lfqueue(const int n_elements)
+	{
+		uint64_t n = 2;
+
+		while(n < uint64_t(n_elements))
+			n <<= 1;
+
+		mask  = n - 1;
+		cells = new cell_t[n];
+
+		for(uint64_t i=0; i<n; i++)
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	~lfqueue()
+	{
+		delete [] cells;
+	}
+
+	// only a snapshot when other threads are busy with the queue
+	bool is_empty()
+	{
+		return dequeue_pos.load(std::memory_order_acquire) >= enqueue_pos.load(std::memory_order_acquire);
+	}
+
+	void interrupt()
+	{
+		interrupted = true;
+	}
+
+	void put(const T & element)
+	{
+		int n = 0;
+
+		while(!try_put(element))
+			backoff(&n);
+	}
+
+	bool try_put(const T & element)
+	{
+		cell_t  *cell = nullptr;
+		uint64_t pos  = enqueue_pos.load(std::memory_order_relaxed);
+
+		for(;;) {
+			cell = &cells[pos & mask];
+
+			int64_t diff = int64_t(cell->sequence.load(std::memory_order_acquire)) - int64_t(pos);
+
+			if (diff == 0) {
+				if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0) {  // full
+				return false;
+			}
+			else {  // claimed by an other producer
+				pos = enqueue_pos.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->data = element;
+		cell->sequence.store(pos + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	std::optional<T> get(const int ms)
+	{
+		auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+
+		int n = 0;
+
+		for(;;) {
+			auto rc = try_get();
+
+			if (rc.has_value() || interrupted)
+				return rc;
+
+			if (std::chrono::steady_clock::now() >= end)
+				return { };
+
+			backoff(&n);
+		}
+	}
+
+	std::optional<T> get()
+	{
+		int n = 0;
+
+		for(;;) {
+			auto rc = try_get();
+
+			if (rc.has_value() || interrupted)
+				return rc;
+
+			backoff(&n);
+		}
+	}
+
+	std::optional<T> try_get()
+	{
+		if (interrupted.load(std::memory_order_relaxed))
+			return { };
+
+		cell_t  *cell = nullptr;
+		uint64_t pos  = dequeue_pos.load(std::memory_order_relaxed);
+
+		for(;;) {
+			cell = &cells[pos & mask];
+
+			int64_t diff = int64_t(cell->sequence.load(std::memory_order_acquire)) - int64_t(pos + 1);
+
+			if (diff == 0) {
+				if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0) {  // empty
+				return { };
+			}
+			else {
+				pos = dequeue_pos.load(std::memory_order_relaxed);
+			}
+		}
+
+		T copy = cell->data;
+		cell->sequence.store(pos + mask + 1, std::memory_order_release);
+
+		return copy;
+	}
+};
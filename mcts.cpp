@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <vector>
+
+#include "board.h"
+#include "helpers.h"
+#include "mcts.h"
+#include "playout.h"
+#include "random.h"
+#include "score.h"
+
+
+// UCT exploration constant
+constexpr double MCTS_EXPLORATION   = 0.7;
+
+// a leaf gets children after this many playouts went through it; keeps the
+// tree (memory) small without losing much of its depth
+constexpr uint32_t MCTS_EXPAND_VISITS = 8;
+
+void mctsFree(mcts_node_t *const node)
+{
+	for(int i=0; i<node->nChildren; i++)
+		mctsFree(&node->children[i]);
+
+	delete [] node->children;
+
+	node->children  = nullptr;
+	node->nChildren = 0;
+	node->state     = MCTS_LEAF;
+	node->visits    = 0;
+	node->wins2     = 0;
+}
+
+bool mctsAdvance(mcts_node_t *const root, const point_t move)
+{
+	mcts_node_t *child = nullptr;
+
+	for(int i=0; i<root->nChildren; i++) {
+		if (root->children[i].move == move) {
+			child = &root->children[i];
+			break;
+		}
+	}
+
+	if (child == nullptr) {
+		mctsFree(root);
+
+		return false;
+	}
+
+	// take the subtree out before the rest (which includes "child") goes
+	mcts_node_t       *children  = child->children;
+	const int          nChildren = child->nChildren;
+	const uint32_t     visits    = child->visits;
+	const uint32_t     wins2     = child->wins2;
+	const mcts_state_t state     = child->state;
+
+	child->children  = nullptr;
+	child->nChildren = 0;
+
+	mctsFree(root);
+
+	root->move      = move;
+	root->children  = children;
+	root->nChildren = nChildren;
+	root->visits    = visits;
+	root->wins2     = wins2;
+	root->state     = state;
+
+	return true;
+}
+
+// only called by the thread that set the node to MCTS_EXPANDING
+static void mctsExpand(mcts_node_t *const node, const Board & b, const player_t p)
+{
+	move_list_t moves;
+	b.generateMoves(playerToStone(p), &moves);
+
+	// no legal moves: a pass (the default "move") is the only child; a
+	// pass is not a child otherwise
+	if (moves.n == 0) {
+		node->children = new mcts_node_t[1];
+		node->nChildren = 1;
+	}
+	else {
+		// random order: unvisited children are tried first-come first-served
+		std::shuffle(moves.moves, moves.moves + moves.n, gen);
+
+		node->children = new mcts_node_t[moves.n];
+
+		for(int i=0; i<moves.n; i++)
+			node->children[i].move = moves.moves[i];
+
+		node->nChildren = moves.n;
+	}
+
+	node->state.store(MCTS_EXPANDED, std::memory_order_release);
+}
+
+static mcts_node_t *mctsSelect(mcts_node_t *const node)
+{
+	const double logN      = log(node->visits.load(std::memory_order_relaxed) + 1.);
+
+	// an expanded node has at least one child: its legal moves, or a single
+	// pass when there are none (see mctsExpand())
+	assert(node->nChildren > 0);
+
+	mcts_node_t *best      = &node->children[0];
+	double       bestValue = -1.;
+
+	for(int i=0; i<node->nChildren; i++) {
+		mcts_node_t   *c = &node->children[i];
+
+		// a thread that is still below "c" counts as a loss for now
+		const uint32_t n = c->visits.load(std::memory_order_relaxed) + c->virtualLoss.load(std::memory_order_relaxed);
+
+		if (n == 0)
+			return c;
+
+		const double value = c->wins2.load(std::memory_order_relaxed) / (2. * n) + MCTS_EXPLORATION * sqrt(logN / n);
+
+		if (value > bestValue) {
+			bestValue = value;
+			best      = c;
+		}
+	}
+
+	return best;
+}
+
+static void mctsThread(mcts_node_t *const root, const Board *const b, const player_t p, const double komi, const Deadline *const stop)
+{
+	Board work(*b);
+
+	PlayoutEngine engine(*b);
+
+	std::vector<mcts_node_t *> path;
+	path.reserve(b->getDim() * b->getDim() * 2);
+
+	while(stop->isStopped() == false) {
+		mcts_node_t *node = root;
+		player_t     cur  = p;
+
+		path.clear();
+		path.push_back(root);
+
+		for(;;) {
+			if (node->state.load(std::memory_order_acquire) != MCTS_EXPANDED) {
+				if (node->visits.load(std::memory_order_relaxed) < MCTS_EXPAND_VISITS || work.getPasses() >= 2)
+					break;
+
+				mcts_state_t expected = MCTS_LEAF;
+
+				// an other thread is expanding it: evaluate it as a leaf
+				if (node->state.compare_exchange_strong(expected, MCTS_EXPANDING) == false)
+					break;
+
+				mctsExpand(node, work, cur);
+			}
+
+			node = mctsSelect(node);
+			node->virtualLoss.fetch_add(1, std::memory_order_relaxed);
+
+			if (node->move == MCTS_PASS)
+				work.pass();
+			else
+				play(&work, node->move, cur);
+
+			cur = getOpponent(cur);
+
+			path.push_back(node);
+		}
+
+		// both passed: the game is over, no need for a playout
+		std::pair<double, double> s;
+
+		if (work.getPasses() >= 2)
+			s = score(work, komi);
+		else {
+			auto rc = engine.playout(work, komi, cur, stop);
+
+			// stopped halfway: nothing to count
+			if (rc.has_value() == false) {
+				for(size_t i=1; i<path.size(); i++) {
+					path[i]->virtualLoss.fetch_sub(1, std::memory_order_relaxed);
+
+					work.unplay();
+				}
+
+				break;
+			}
+
+			s = { std::get<0>(rc.value()), std::get<1>(rc.value()) };
+		}
+
+		const uint32_t blackWins2 = s.first > s.second ? 2 : (s.first == s.second ? 1 : 0);
+
+		root->visits.fetch_add(1, std::memory_order_relaxed);
+
+		// path[i] was reached by a move of "p" when i is odd
+		for(size_t i=1; i<path.size(); i++) {
+			const bool byBlack = (i & 1) == (p == P_BLACK);
+
+			path[i]->wins2.fetch_add(byBlack ? blackWins2 : 2 - blackWins2, std::memory_order_relaxed);
+			path[i]->visits.fetch_add(1, std::memory_order_relaxed);
+			path[i]->virtualLoss.fetch_sub(1, std::memory_order_relaxed);
+
+			work.unplay();
+		}
+	}
+}
+
+void mctsStart(mcts_node_t *const root, const Board & b, const player_t p, const double komi, ThreadPool *const pool, const Deadline *const stop)
+{
+	// the root is expanded up front, else all threads would start with playouts from it
+	if (root->state.load() == MCTS_LEAF) {
+		root->state = MCTS_EXPANDING;
+
+		mctsExpand(root, b, p);
+	}
+
+	pool->start([root, &b, p, komi, stop](const int nr) { mctsThread(root, &b, p, komi, stop); }, pool->getN());
+}
+
+void mctsSearch(mcts_node_t *const root, const Board & b, const player_t p, const double komi, ThreadPool *const pool, const Deadline *const stop)
+{
+	mctsStart(root, b, p, komi, pool, stop);
+
+	pool->wait();
+}
+
+const mcts_node_t *mctsBestChild(const mcts_node_t & node)
+{
+	if (node.state.load(std::memory_order_acquire) != MCTS_EXPANDED)
+		return nullptr;
+
+	const mcts_node_t *best = nullptr;
+
+	for(int i=0; i<node.nChildren; i++) {
+		if (best == nullptr || node.children[i].visits > best->visits)
+			best = &node.children[i];
+	}
+
+	return best;
+}
+
+std::vector<point_t> mctsGetPv(const mcts_node_t & node)
+{
+	std::vector<point_t> pv;
+
+	for(const mcts_node_t *cur = mctsBestChild(node); cur && cur->visits > 0; cur = mctsBestChild(*cur))
+		pv.push_back(cur->move);
+
+	return pv;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+#include "board.h"
+#include "pool.h"
+
+
+constexpr point_t MCTS_PASS = 0xffff;
+
+typedef enum { MCTS_LEAF, MCTS_EXPANDING, MCTS_EXPANDED } mcts_state_t;
+
+// a node of the search tree that is shared by all search threads
+// the statistics are updated with atomics only, the children are created
+// once by the thread that wins the MCTS_LEAF -> MCTS_EXPANDING transition
+typedef struct mcts_node {
+	point_t                   move        { MCTS_PASS  };  // that led to this node
+	std::atomic_uint32_t      visits      { 0          };
+	std::atomic_uint32_t      wins2       { 0          };  // 2 per win, 1 per draw, for the player that made "move"
+	std::atomic_uint32_t      virtualLoss { 0          };  // threads that are below this node right now
+	std::atomic<mcts_state_t> state       { MCTS_LEAF  };
+	struct mcts_node         *children    { nullptr    };
+	int                       nChildren   { 0          };
+} mcts_node_t;
+
+// frees the children of "node" (recursively) and clears its statistics
+void mctsFree(mcts_node_t *const node);
+
+// makes the subtree of the child for "move" (or MCTS_PASS) the new root, the
+// rest of the tree is freed; false (and an empty root) if there's no such child
+// not while a search is running
+bool mctsAdvance(mcts_node_t *const root, const point_t move);
+
+// grows the tree below "root" (the position "b" with "p" to move) on all
+// threads of "pool" until "stop" says so
+void mctsSearch(mcts_node_t *const root, const Board & b, const player_t p, const double komi, ThreadPool *const pool, const Deadline *const stop);
+// the same but returns at once, pool->wait() for the search to end
+// "b" and "stop" must stay valid until then
+void mctsStart(mcts_node_t *const root, const Board & b, const player_t p, const double komi, ThreadPool *const pool, const Deadline *const stop);
+
+// the child with the most visits, nullptr if there are none
+const mcts_node_t *mctsBestChild(const mcts_node_t & node);
+
+// the moves the tree expects from "node" on
+std::vector<point_t> mctsGetPv(const mcts_node_t & node);
@@ -0,0 +1,107 @@
+#include <random>
+#include <tuple>
+
+#include "board.h"
+#include "helpers.h"
+#include "playout.h"
+#include "random.h"
+#include "score.h"
+
+
+// how many moves are made between two looks at the deadline
+constexpr int PLAYOUT_CHECK_INTERVAL = 16;
+
+// a playout is cut off after dim * dim * this many moves
+constexpr int PLAYOUT_MAX_MOVES_FACTOR = 3;
+
+// "pv" is a single cross eye of "what": all neighbours are its stones (or the
+// edge) and at most one diagonal (none on the edge) is held by the opponent,
+// so that false eyes still get filled
+static bool isOwnEye(const Board & b, const int pv, const board_t what)
+{
+	const int *offsets = b.getNeighbourOffsets();
+
+	for(int i=0; i<4; i++) {
+		const board_t n = b.getAtPadded(pv + offsets[i]);
+
+		if (n != what && n != B_EDGE)
+			return false;
+	}
+
+	const int     pdim      = b.getPaddedDim();
+	const int     diagonals[] { -pdim - 1, -pdim + 1, pdim - 1, pdim + 1 };
+	const board_t opponent  = what == B_BLACK ? B_WHITE : B_BLACK;
+
+	int  bad  = 0;
+	bool edge = false;
+
+	for(int i=0; i<4; i++) {
+		const board_t d = b.getAtPadded(pv + diagonals[i]);
+
+		if (d == B_EDGE)
+			edge = true;
+		else if (d == opponent)
+			bad++;
+	}
+
+	return bad < (edge ? 1 : 2);
+}
+
+PlayoutEngine::PlayoutEngine(const Board & root) : b(root)
+{
+}
+
+PlayoutEngine::~PlayoutEngine()
+{
+}
+
+std::optional<std::tuple<double, double, int> > PlayoutEngine::playout(const Board & in, const double komi, player_t p, const Deadline *const stop)
+{
+	b.assign(in);
+
+	const int dim = b.getDim();
+
+	const board_t stones[] { playerToStone(P_BLACK), playerToStone(P_WHITE) };
+
+	int  mc      { 0     };
+
+	bool pass[2] { false };
+
+	while(++mc < dim * dim * PLAYOUT_MAX_MOVES_FACTOR) {
+		// a 19x19 playout can take long
+		if (stop && mc % PLAYOUT_CHECK_INTERVAL == 0 && stop->isStopped())
+			return { };
+
+		b.generateMoves(stones[p], &moves);
+
+		// filling an own eye is never useful and keeps the playout from ending
+		int n = 0;
+
+		for(int i=0; i<moves.n; i++) {
+			if (isOwnEye(b, toPadded(moves.moves[i], dim), stones[p]) == false)
+				moves.moves[n++] = moves.moves[i];
+		}
+
+		// no moves left, or a random pass
+		std::uniform_int_distribution<> rng(0, n);
+		const int r = n ? rng(gen) : n;
+
+		if (r == n) {
+			pass[p] = true;
+
+			if (pass[0] && pass[1])
+				break;
+		}
+		else {
+			pass[p] = false;
+
+			play(&b, moves.moves[r], p);
+		}
+
+		p = getOpponent(p);
+	}
+
+	auto s = score(b, komi);
+
+	return std::tuple<double, double, int>(s.first, s.second, mc);
+}
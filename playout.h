@@ -0,0 +1,30 @@
+#pragma once
+
+#include <optional>
+#include <tuple>
+
+#include "board.h"
+#include "pool.h"
+
+
+// one per thread: plays random moves for "p" and its opponent, never filling
+// a single cross eye of their own, until both pass in a row; then scores
+// the board it plays on is made once and for each playout overwritten with
+// the start position (Board::assign()), so that its buffers are re-used: once
+// warmed up, a playout does no heap allocations
+class PlayoutEngine
+{
+private:
+	Board       b;
+	move_list_t moves;
+
+public:
+	// "root": any position with the dimensions of the ones that will be played out
+	PlayoutEngine(const Board & root);
+	virtual ~PlayoutEngine();
+
+	// returns the score of black, of white and the number of moves made;
+	// nothing when "stop" (if not nullptr) said so before the playout was
+	// finished
+	std::optional<std::tuple<double, double, int> > playout(const Board & in, const double komi, player_t p, const Deadline *const stop);
+};
@@ -0,0 +1,188 @@
+#include <assert.h>
+#include <chrono>
+
+#include "pool.h"
+#include "time.h"
+
+
+Deadline::Deadline(const uint64_t end_t, const Deadline *const parent) : end_t(end_t), parent(parent)
+{
+}
+
+Deadline::~Deadline()
+{
+}
+
+uint64_t Deadline::getEnd() const
+{
+	return end_t;
+}
+
+void Deadline::cancel()
+{
+	cancelled = true;
+}
+
+bool Deadline::isCancelled() const
+{
+	return cancelled.load(std::memory_order_relaxed) || (parent && parent->isCancelled());
+}
+
+bool Deadline::isTimeUp() const
+{
+	return end_t != UINT64_MAX && get_ts_ms() >= end_t;
+}
+
+bool Deadline::isStopped() const
+{
+	return isCancelled() || isTimeUp();
+}
+
+Watchdog::Watchdog()
+{
+	th = std::thread(&Watchdog::worker, this);
+}
+
+Watchdog::~Watchdog()
+{
+	{
+		std::unique_lock<std::mutex> lck(lock);
+
+		quit = true;
+
+		cv.notify_all();
+	}
+
+	th.join();
+}
+
+void Watchdog::worker()
+{
+	std::unique_lock<std::mutex> lck(lock);
+
+	while(!quit) {
+		if (!armed) {
+			cv.wait(lck);
+			continue;
+		}
+
+		uint64_t now = get_ts_ms();
+
+		if (now < end_t) {
+			cv.wait_for(lck, std::chrono::milliseconds(end_t - now));
+			continue;
+		}
+
+		// under the lock: disarm() waits for it
+		f();
+
+		armed = false;
+		fired = true;
+	}
+}
+
+void Watchdog::arm(const uint64_t end_t, const std::function<void()> & f)
+{
+	std::unique_lock<std::mutex> lck(lock);
+
+	this->end_t = end_t;
+	this->f     = f;
+
+	armed = true;
+	fired = false;
+
+	cv.notify_all();
+}
+
+bool Watchdog::disarm()
+{
+	std::unique_lock<std::mutex> lck(lock);
+
+	armed = false;
+
+	cv.notify_all();
+
+	return fired;
+}
+
+ThreadPool::ThreadPool(const int n)
+{
+	for(int i=0; i<n; i++)
+		threads.emplace_back(&ThreadPool::worker, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock<std::mutex> lck(lock);
+
+		quit = true;
+
+		cvStart.notify_all();
+	}
+
+	for(auto & t : threads)
+		t.join();
+}
+
+int ThreadPool::getN() const
+{
+	return threads.size();
+}
+
+void ThreadPool::worker(const int nr)
+{
+	uint64_t seen = 0;
+
+	std::unique_lock<std::mutex> lck(lock);
+
+	for(;;) {
+		cvStart.wait(lck, [&] { return quit || (generation != seen && nr < nJob); });
+
+		if (quit)
+			break;
+
+		seen = generation;
+
+		auto f = job;
+
+		lck.unlock();
+
+		f(nr);
+
+		lck.lock();
+
+		if (--running == 0)
+			cvDone.notify_all();
+	}
+}
+
+void ThreadPool::start(const std::function<void(const int)> & f, const int n)
+{
+	std::unique_lock<std::mutex> lck(lock);
+
+	assert(running == 0);
+	assert(n > 0 && n <= int(threads.size()));
+
+	job     = f;
+	nJob    = n;
+	running = n;
+
+	generation++;
+
+	cvStart.notify_all();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lck(lock);
+
+	cvDone.wait(lck, [&] { return running == 0; });
+}
+
+void ThreadPool::run(const std::function<void(const int)> & f)
+{
+	start(f, threads.size());
+
+	wait();
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+
+// when a search has to end: at "end_t" (ms, see get_ts_ms()) or earlier
+// when cancelled, or when "parent" (if any) is; the one thing all search
+// threads poll
+class Deadline
+{
+private:
+	const uint64_t        end_t     { UINT64_MAX };
+	const Deadline *const parent    { nullptr    };
+	std::atomic_bool      cancelled { false      };
+
+public:
+	Deadline(const uint64_t end_t, const Deadline *const parent = nullptr);
+	virtual ~Deadline();
+
+	uint64_t getEnd() const;
+
+	void cancel();
+	bool isCancelled() const;
+	bool isTimeUp() const;
+	// either of the two
+	bool isStopped() const;
+};
+
+// a thread that calls a function when it was not disarmed in time: for
+// when a search does not return when it should
+class Watchdog
+{
+private:
+	std::thread             th;
+
+	std::mutex              lock;
+	std::condition_variable cv;
+
+	std::function<void()>   f;
+	uint64_t                end_t { 0     };
+	bool                    armed { false };
+	bool                    fired { false };
+	bool                    quit  { false };
+
+	void worker();
+
+public:
+	Watchdog();
+	virtual ~Watchdog();
+
+	// "f" is called (on the watchdog thread) at "end_t" (ms, see get_ts_ms())
+	void arm(const uint64_t end_t, const std::function<void()> & f);
+	// true when "f" was called; returns after "f" has finished
+	bool disarm();
+};
+
+// threads that are started once (-t) and then run the work of all searches
+// one job at a time: a job is a function that is called on n of the threads,
+// with the thread-number (0...n-1) as parameter
+class ThreadPool
+{
+private:
+	std::vector<std::thread>       threads;
+
+	std::mutex                     lock;
+	std::condition_variable        cvStart;
+	std::condition_variable        cvDone;
+
+	std::function<void(const int)> job;
+	uint64_t                       generation { 0     };
+	int                            nJob       { 0     };
+	int                            running    { 0     };
+	bool                           quit       { false };
+
+	void worker(const int nr);
+
+public:
+	ThreadPool(const int n);
+	virtual ~ThreadPool();
+
+	int getN() const;
+
+	// returns at once, n is at most getN()
+	void start(const std::function<void(const int)> & f, const int n);
+	// until the job that was started is finished
+	void wait();
+	// start() on all threads + wait()
+	void run(const std::function<void(const int)> & f);
+};
@@ -1,3 +1,4 @@
+#include <string.h>
 #include <string>
 #include <utility>
 
@@ -5,69 +6,88 @@
 #include "str.h"
 
 
-void scoreFloodFill(const Board & b, const int dim, bool *const reachable, const int x, const int y, const board_t lookFor)
+// marks the empty crosses that are connected to a stone of "from" by a path of empty crosses
+static void scoreReach(const Board & b, const board_t from, bool *const reach)
 {
-	auto piece = b.getAt(x, y);
+	const int  dim     = b.getDim();
+	const int  pdim    = b.getPaddedDim();
+	const int *offsets = b.getNeighbourOffsets();
 
-	int v = y * dim + x;
+	int stack[MAX_DIM * MAX_DIM];
+	int sp = 0;
 
-	if (piece != lookFor || reachable[v])
-		return;
+	for(int y=1; y<=dim; y++) {
+		for(int pv=y * pdim + 1, end=pv + dim; pv<end; pv++) {
+			if (b.getAtPadded(pv) != from)
+				continue;
 
-	reachable[v] = true;
+			for(int i=0; i<4; i++) {
+				const int pn = pv + offsets[i];
 
-	const int dimm1 = dim - 1;
+				if (b.getAtPadded(pn) == B_EMPTY && reach[pn] == false)
+					reach[pn] = true, stack[sp++] = pn;
+			}
+		}
+	}
 
-	if (x > 0)
-		scoreFloodFill(b, dim, reachable, x - 1, y, lookFor);
-	if (x < dimm1)
-		scoreFloodFill(b, dim, reachable, x + 1, y, lookFor);
+	while(sp) {
+		const int pv = stack[--sp];
 
-	if (y > 0)
-		scoreFloodFill(b, dim, reachable, x, y - 1, lookFor);
-	if (y < dimm1)
-		scoreFloodFill(b, dim, reachable, x, y + 1, lookFor);
+		for(int i=0; i<4; i++) {
+			const int pn = pv + offsets[i];
+
+			if (b.getAtPadded(pn) == B_EMPTY && reach[pn] == false)
+				reach[pn] = true, stack[sp++] = pn;
+		}
+	}
 }
 
+// Tromp-Taylor area scoring: stones + the empty crosses that only reach stones of that color
 // black, white
 std::pair<double, double> score(const Board & b, const double komi)
 {
-	const int dim = b.getDim();
-	const int dimsq = dim * dim;
-
-	int blackStones = 0;
-	int whiteStones = 0;
-	bool *reachableBlack = new bool[dimsq]();
-	bool *reachableWhite = new bool[dimsq]();
-
-	for(int y=0; y<dim; y++) {
-		for(int x=0; x<dim; x++) {
-			auto piece = b.getAt(x, y);
-
-			if (piece == B_BLACK)
-				scoreFloodFill(b, dim, reachableBlack, x, y, B_BLACK);
-			else if (piece == B_WHITE)
-				scoreFloodFill(b, dim, reachableWhite, x, y, B_WHITE);
-		}
-	}
+	if (b.hasBitplanes()) {
+		const auto      & g     = getBitboardGeometry(b.getDim());
+		const bitplane_t & black = b.getPlane(B_BLACK);
+		const bitplane_t & white = b.getPlane(B_WHITE);
+		const bitplane_t   empty = bitplaneAndNot(g.on_board, bitplaneOr(black, white));
+
+		const bitplane_t reachBlack = bitplaneFlood(bitplaneAnd(bitplaneDilate(black, g), empty), empty, g);
+		const bitplane_t reachWhite = bitplaneFlood(bitplaneAnd(bitplaneDilate(white, g), empty), empty, g);
 
-	int blackEmpty = 0;
-	int whiteEmpty = 0;
+		const int blackArea = bitplaneCount(black) + bitplaneCount(bitplaneAndNot(reachBlack, reachWhite));
+		const int whiteArea = bitplaneCount(white) + bitplaneCount(bitplaneAndNot(reachWhite, reachBlack));
 
-	for(int i=0; i<dimsq; i++) {
-		if (reachableBlack[i] == true && reachableWhite[i] == false)
-			blackEmpty++;
-		else if (reachableWhite[i] == true && reachableBlack[i] == false)
-			whiteEmpty++;
+		return { double(blackArea), whiteArea + komi };
 	}
 
-	delete [] reachableBlack;
-	delete [] reachableWhite;
+	const int dim  = b.getDim();
+	const int pdim = b.getPaddedDim();
 
-	double blackScore = blackStones + blackEmpty;
-	double whiteScore = whiteStones + whiteEmpty + komi;
+	bool reachBlack[(MAX_DIM + 2) * (MAX_DIM + 2)];
+	bool reachWhite[(MAX_DIM + 2) * (MAX_DIM + 2)];
+
+	memset(reachBlack, 0x00, pdim * pdim * sizeof(bool));
+	memset(reachWhite, 0x00, pdim * pdim * sizeof(bool));
+
+	scoreReach(b, B_BLACK, reachBlack);
+	scoreReach(b, B_WHITE, reachWhite);
+
+	int blackArea = 0;
+	int whiteArea = 0;
+
+	for(int y=1; y<=dim; y++) {
+		for(int pv=y * pdim + 1, end=pv + dim; pv<end; pv++) {
+			auto piece = b.getAtPadded(pv);
+
+			if (piece == B_BLACK || (reachBlack[pv] == true && reachWhite[pv] == false))
+				blackArea++;
+			else if (piece == B_WHITE || (reachWhite[pv] == true && reachBlack[pv] == false))
+				whiteArea++;
+		}
+	}
 
-	return { blackScore, whiteScore };
+	return { double(blackArea), whiteArea + komi };
 }
 
 std::string scoreStr(const std::pair<double, double> & scores)
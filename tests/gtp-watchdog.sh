@@ -0,0 +1,21 @@
+#!/bin/sh
+# genmove with a watchdog that goes off long before the search would end (a
+# negative slack): the complete response ("=id move" and the empty line) has
+# to be there in time, and the next command may not wait for the search
+# byo-yomi of 5s for 1 stone: a limit of 4.75s, the watchdog fires at 0.75s
+
+BIN="$1"
+
+START=$(date +%s%N)
+
+OUT=$( (printf '1 boardsize 9\n2 clear_board\n3 time_settings 0 5 1\n4 genmove b\n5 name\n'; sleep 6; printf '6 quit\n') | "$BIN" -t 1 -w -4000 | while IFS= read -r line; do
+		echo "$(( ($(date +%s%N) - START) / 1000000 )) [$line]"
+	done)
+
+echo "$OUT"
+
+echo "$OUT" | awk '
+	/ \[=4 [A-Z][0-9]+\]$/ || / \[=4 pass\]$/ { answer = NR }
+	answer && NR == answer + 1 && / \[\]$/ && $1 < 2500 { framed = 1 }
+	/ \[=5 / && $1 < 2500 { next_ok = 1 }
+	END { exit !(framed && next_ok) }'
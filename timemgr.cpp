@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <vector>
+
+#include "str.h"
+#include "timemgr.h"
+
+
+// nothing known: this many seconds for the rest of the game (as before there was a time manager)
+constexpr double TM_UNKNOWN_TOTAL      = 5.0;
+// no time limit
+constexpr double TM_UNLIMITED_PER_MOVE = 2.0;
+// never plan for fewer moves than this
+constexpr double TM_MIN_MOVES_LEFT     = 10.0;
+// the part of the remaining main time that one move may take at most
+constexpr double TM_MAX_FRACTION       = 0.3;
+// how far beyond its target a move may go when the search is unsure
+constexpr double TM_EXTEND             = 2.0;
+// out of time (less left than the margin): still enough for the fast heuristics
+constexpr double TM_MIN_PER_MOVE       = 0.01;
+
+TimeManager::TimeManager(const double margin) : margin(margin)
+{
+}
+
+TimeManager::~TimeManager()
+{
+}
+
+void TimeManager::setMargin(const double margin)
+{
+	this->margin = margin;
+}
+
+void TimeManager::setSettings(const time_control_t type, const double mainTime, const double byoTime, const int byoStones)
+{
+	this->type      = type;
+	this->mainTime  = mainTime;
+	this->byoTime   = byoTime;
+	this->byoStones = byoStones;
+
+	newGame();
+}
+
+time_control_t TimeManager::getType() const
+{
+	return type;
+}
+
+void TimeManager::newGame()
+{
+	for(auto & c : clocks) {
+		c.timeLeft = mainTime;
+		c.stones   = 0;
+
+		// no main time: straight into byo-yomi
+		if (mainTime <= 0. && (type == TC_CANADIAN || type == TC_JAPANESE)) {
+			c.timeLeft = byoTime;
+			c.stones   = byoStones;
+		}
+	}
+}
+
+void TimeManager::setTimeLeft(const player_t p, const double timeLeft, const int stones)
+{
+	// time_left without time_settings: assume that it is all there is
+	if (type == TC_UNKNOWN) {
+		type     = TC_ABSOLUTE;
+		mainTime = timeLeft;
+	}
+
+	clocks[p].timeLeft = timeLeft;
+	clocks[p].stones   = stones;
+}
+
+// what a move may take once in byo-yomi
+double TimeManager::getByoPerMove() const
+{
+	if (type == TC_CANADIAN)
+		return byoTime / std::max(1, byoStones);
+
+	if (type == TC_JAPANESE)
+		return byoTime;
+
+	return 0.;
+}
+
+double TimeManager::getTimeLeft(const player_t p) const
+{
+	return clocks[p].timeLeft;
+}
+
+time_budget_t TimeManager::allocate(const player_t p, const Board & b, const int nLegal) const
+{
+	if (type == TC_UNKNOWN) {
+		double target = TM_UNKNOWN_TOTAL / std::max(1, nLegal);
+
+		return { target, target };
+	}
+
+	if (type == TC_NONE)
+		return { TM_UNLIMITED_PER_MOVE, TM_UNLIMITED_PER_MOVE * TM_EXTEND };
+
+	const player_clock_t & c = clocks[p];
+
+	double target = 0.;
+	double limit  = 0.;
+
+	if (c.stones > 0) {
+		// Canadian: the time left is for the rest of the stones of this
+		// period, an extension is taken from the later ones; Japanese: each
+		// move has a full period, one more second would cost a period
+		if (type == TC_CANADIAN) {
+			target = (c.timeLeft - margin) / c.stones;
+			limit  = (c.timeLeft - margin) / ((c.stones + 1) / 2.);
+		}
+		else {
+			target = std::min(c.timeLeft, byoTime) - margin;
+			limit  = target;
+		}
+	}
+	else {
+		// about half of the empty crosses will be filled by us, more or
+		// less; the opening and the endgame take less thinking than the
+		// middle game
+		const int    dimsq     = b.getDim() * b.getDim();
+		const double fill      = 1. - double(nLegal) / dimsq;
+		const double movesLeft = std::max(TM_MIN_MOVES_LEFT, nLegal * 0.45);
+
+		double phase = 1.0;
+
+		if (fill < 0.1)
+			phase = 0.8;
+		else if (fill < 0.6)
+			phase = 1.25;
+
+		const double available = c.timeLeft - margin;
+		const double byo       = getByoPerMove();
+
+		limit  = available * TM_MAX_FRACTION;
+		target = std::min(available / movesLeft * phase, limit);
+		limit  = std::min(limit, target * TM_EXTEND);
+
+		// the byo-yomi is there anyway when the main time runs out
+		if (byo > 0.) {
+			target = std::max(target, std::min(available, byo - margin) * 0.5);
+			limit  = std::max(limit, target);
+		}
+	}
+
+	return { std::max(TM_MIN_PER_MOVE, target), std::max(TM_MIN_PER_MOVE, limit) };
+}
+
+void TimeManager::moveDone(const player_t p, const double used)
+{
+	if (type == TC_UNKNOWN || type == TC_NONE)
+		return;
+
+	player_clock_t & c = clocks[p];
+
+	if (c.stones == 0) {
+		c.timeLeft -= used;
+
+		if (c.timeLeft < 0. && (type == TC_CANADIAN || type == TC_JAPANESE)) {
+			c.timeLeft = byoTime;
+			c.stones   = byoStones;
+		}
+
+		return;
+	}
+
+	if (type == TC_CANADIAN) {
+		c.timeLeft -= used;
+
+		// period completed: a new one begins
+		if (--c.stones == 0) {
+			c.timeLeft = byoTime;
+			c.stones   = byoStones;
+		}
+	}
+	else if (type == TC_JAPANESE) {
+		// a period is used up when a move takes longer than it
+		if (used > c.timeLeft && c.stones > 1)
+			c.stones--;
+
+		c.timeLeft = byoTime;
+	}
+}
+
+std::string TimeManager::toString(const player_t p) const
+{
+	const char *const names[] = { "unknown", "none", "absolute", "canadian", "japanese" };
+
+	return myformat("%s, main: %.1fs, byo-yomi: %.1fs/%d, left: %.1fs/%d, margin: %.3fs", names[type], mainTime, byoTime, byoStones, clocks[p].timeLeft, clocks[p].stones, margin);
+}
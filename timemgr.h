@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+
+#include "board.h"
+
+
+// TC_UNKNOWN: no time_settings were received
+// TC_NONE: no time limit
+// TC_ABSOLUTE: main time only
+// TC_CANADIAN: after the main time, "byoStones" moves per "byoTime" seconds
+// TC_JAPANESE: after the main time, "byoStones" periods of "byoTime" seconds
+//              of which one is lost each time a move takes longer
+typedef enum { TC_UNKNOWN, TC_NONE, TC_ABSOLUTE, TC_CANADIAN, TC_JAPANESE } time_control_t;
+
+// in seconds: what a move should take, and how long it may take when the
+// search is unsure about the best move
+typedef struct {
+	double target;
+	double limit;
+} time_budget_t;
+
+// keeps track of the clocks of both players and decides how much time a
+// move may take
+class TimeManager
+{
+private:
+	time_control_t type      { TC_UNKNOWN };
+	double         mainTime  { 0.         };
+	double         byoTime   { 0.         };
+	int            byoStones { 0          };
+
+	// kept off every allocation for the GTP round trip and the moment the
+	// controller starts our clock earlier than we do
+	double         margin    { 0.         };
+
+	// as in "time_left": the time left in the current stage and, in
+	// byo-yomi, the stones (Canadian) or periods (Japanese) left; 0 while in
+	// the main time
+	typedef struct {
+		double timeLeft;
+		int    stones;
+	} player_clock_t;
+
+	player_clock_t clocks[2] { { 0., 0 }, { 0., 0 } };
+
+	double getByoPerMove() const;
+
+public:
+	TimeManager(const double margin);
+	virtual ~TimeManager();
+
+	void setMargin(const double margin);
+
+	// GTP "time_settings" and the "kgs-time_settings" variants
+	void setSettings(const time_control_t type, const double mainTime, const double byoTime, const int byoStones);
+	time_control_t getType() const;
+
+	// resets the clocks to the settings
+	void newGame();
+
+	// GTP "time_left"
+	void setTimeLeft(const player_t p, const double timeLeft, const int stones);
+	// in the current stage
+	double getTimeLeft(const player_t p) const;
+
+	// the time a move of "p" may take in position "b" with "nLegal" legal
+	// moves; never 0, there's always time for a (quick) move
+	time_budget_t allocate(const player_t p, const Board & b, const int nLegal) const;
+
+	// "p" took "used" seconds for a move; for when no "time_left" follows
+	void moveDone(const player_t p, const double used);
+
+	std::string toString(const player_t p) const;
+};
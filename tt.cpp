@@ -0,0 +1,127 @@
+#include <algorithm>
+
+#include "tt.h"
+
+
+// data: score (16 bits) | move (16) | depth (8) | bound (8) | age (8)
+constexpr uint16_t TT_NO_MOVE = 0xffff;
+
+static uint64_t pack(const int depth, const int score, const tt_bound_t bound, const std::optional<point_t> & move, const uint8_t age)
+{
+	return uint64_t(uint16_t(int16_t(score))) |
+		(uint64_t(move.has_value() ? move.value() : TT_NO_MOVE) << 16) |
+		(uint64_t(uint8_t(depth)) << 32) |
+		(uint64_t(bound) << 40) |
+		(uint64_t(age) << 48);
+}
+
+static int getDepth(const uint64_t data)
+{
+	return uint8_t(data >> 32);
+}
+
+static uint8_t getAge(const uint64_t data)
+{
+	return uint8_t(data >> 48);
+}
+
+TranspositionTable::TranspositionTable(const size_t mb)
+{
+	resize(mb);
+}
+
+TranspositionTable::~TranspositionTable()
+{
+	delete [] buckets;
+}
+
+void TranspositionTable::resize(const size_t mb)
+{
+	delete [] buckets;
+
+	nBuckets = std::max(size_t(1), mb * 1024 * 1024 / sizeof(tt_bucket_t));
+	buckets  = new tt_bucket_t[nBuckets];
+
+	clear();
+}
+
+void TranspositionTable::clear()
+{
+	for(uint64_t i=0; i<nBuckets; i++) {
+		for(auto & slot : buckets[i].slots) {
+			slot.check.store(0, std::memory_order_relaxed);
+			slot.data .store(0, std::memory_order_relaxed);
+		}
+	}
+
+	age = 0;
+}
+
+size_t TranspositionTable::getSizeMB() const
+{
+	return nBuckets * sizeof(tt_bucket_t) / (1024 * 1024);
+}
+
+void TranspositionTable::newSearch()
+{
+	age++;
+}
+
+std::optional<tt_entry_t> TranspositionTable::lookup(const uint64_t key) const
+{
+	const tt_bucket_t & bucket = buckets[key % nBuckets];
+
+	for(auto & slot : bucket.slots) {
+		uint64_t data = slot.data.load(std::memory_order_relaxed);
+
+		if ((slot.check.load(std::memory_order_relaxed) ^ data) != key || data == 0)
+			continue;
+
+		tt_entry_t entry;
+		entry.score = int16_t(uint16_t(data));
+		entry.depth = getDepth(data);
+		entry.bound = tt_bound_t(uint8_t(data >> 40));
+
+		uint16_t move = uint16_t(data >> 16);
+		if (move != TT_NO_MOVE)
+			entry.move = move;
+
+		return entry;
+	}
+
+	return { };
+}
+
+void TranspositionTable::store(const uint64_t key, const int depth, const int score, const tt_bound_t bound, const std::optional<point_t> & move)
+{
+	tt_bucket_t & bucket = buckets[key % nBuckets];
+
+	// the same position, else the least valuable: from an older search, then the shallowest
+	tt_slot_t *target     = nullptr;
+	int        worstValue = 1 << 30;
+
+	for(auto & slot : bucket.slots) {
+		uint64_t data = slot.data.load(std::memory_order_relaxed);
+
+		if ((slot.check.load(std::memory_order_relaxed) ^ data) == key) {
+			// keep the best move of a deeper search of this position
+			if (getDepth(data) > depth && getAge(data) == age)
+				return;
+
+			target = &slot;
+			break;
+		}
+
+		int value = getDepth(data) + (getAge(data) == age ? 256 : 0);
+
+		if (value < worstValue) {
+			worstValue = value;
+			target     = &slot;
+		}
+	}
+
+	uint64_t data = pack(depth, score, bound, move, age);
+
+	target->check.store(key ^ data, std::memory_order_relaxed);
+	target->data .store(data,       std::memory_order_relaxed);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "board.h"
+
+
+typedef enum { TT_EXACT, TT_LOWER, TT_UPPER } tt_bound_t;
+
+typedef struct {
+	int                    score;
+	int                    depth;
+	tt_bound_t             bound;
+	std::optional<point_t> move;
+} tt_entry_t;
+
+// results of search() per position (Board::getKey())
+// an entry is two words: the key xor'ed with the data, and the data; a
+// torn write by two threads then no longer matches the key so that no
+// locks are needed
+class TranspositionTable
+{
+private:
+	static constexpr int ENTRIES_PER_BUCKET = 4;  // 64 bytes: 1 cache line
+
+	typedef struct {
+		std::atomic_uint64_t check;  // key ^ data
+		std::atomic_uint64_t data;
+	} tt_slot_t;
+
+	typedef struct alignas(64) {
+		tt_slot_t slots[ENTRIES_PER_BUCKET];
+	} tt_bucket_t;
+
+	tt_bucket_t *buckets  { nullptr };
+	uint64_t     nBuckets { 0       };
+	uint8_t      age      { 0       };
+
+public:
+	TranspositionTable(const size_t mb);
+	virtual ~TranspositionTable();
+
+	// clears the table; not while a search is running
+	void resize(const size_t mb);
+	void clear();
+
+	size_t getSizeMB() const;
+
+	// entries of older searches are replaced first
+	void newSearch();
+
+	std::optional<tt_entry_t> lookup(const uint64_t key) const;
+	void store(const uint64_t key, const int depth, const int score, const tt_bound_t bound, const std::optional<point_t> & move);
+};
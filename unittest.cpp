@@ -1,16 +1,20 @@
 #include <assert.h>
+#include <cmath>
 #include <limits.h>
 #include <optional>
 #include <random>
 #include <stdio.h>
 #include <vector>
 
+#include "alphabeta.h"
 #include "board.h"
 #include "dump.h"
 #include "helpers.h"
 #include "io.h"
+#include "lfqueue.h"
 #include "random.h"
 #include "score.h"
+#include "timemgr.h"
 #include "vertex.h"
 
 bool verifyChainsAndMap(const std::vector<chain_t *> & chainsW, const std::vector<chain_t *> & chainsB, const std::string & name, const ChainMap & cm, const bool verbose)
@@ -21,7 +25,7 @@ bool verifyChainsAndMap(const std::vector<chain_t *> & chainsW, const std::vecto
 		for(auto & stone : chain->chain) {
 			if (cm.getAt(stone) != chain) {
 				auto p = cm.getAt(stone);
-				send(verbose, "# (%s) stone %s not in map. map: %s, chain: %s", name.c_str(), v2t(stone).c_str(), p ? board_t_name(p->type) : ".", board_t_name(chain->type));
+				send(verbose, "# (%s) stone %s not in map. map: %s, chain: %s", name.c_str(), v2t({ stone, cm.getDim() }).c_str(), p ? board_t_name(p->type) : ".", board_t_name(chain->type));
 				ok = false;
 			}
 		}
@@ -31,7 +35,7 @@ bool verifyChainsAndMap(const std::vector<chain_t *> & chainsW, const std::vecto
 		for(auto & stone : chain->chain) {
 			if (cm.getAt(stone) != chain) {
 				auto p = cm.getAt(stone);
-				send(verbose, "# (%s) stone %s not in map. map: %s, chain: %s", name.c_str(), v2t(stone).c_str(), p ? board_t_name(p->type) : ".", board_t_name(chain->type));
+				send(verbose, "# (%s) stone %s not in map. map: %s, chain: %s", name.c_str(), v2t({ stone, cm.getDim() }).c_str(), p ? board_t_name(p->type) : ".", board_t_name(chain->type));
 				ok = false;
 			}
 		}
@@ -43,7 +47,7 @@ bool verifyChainsAndMap(const std::vector<chain_t *> & chainsW, const std::vecto
 		for(int x=0; x<dim; x++) {
 			Vertex v(x, y, dim);
 
-			auto p = cm.getAt(v);
+			auto p = cm.getAt(v.getV());
 			if (!p)
 				continue;
 
@@ -56,7 +60,7 @@ bool verifyChainsAndMap(const std::vector<chain_t *> & chainsW, const std::vecto
 				ok = false;
 			}
 			else {
-				auto it2 = std::find((*it)->chain.begin(), (*it)->chain.end(), v);
+				auto it2 = std::find((*it)->chain.begin(), (*it)->chain.end(), v.getV());
 
 				if (it2 == (*it)->chain.end()) {
 					send(verbose, "# %s not in mapped chain", v2t(v).c_str());
@@ -89,20 +93,20 @@ bool test_connect_play(const Board & b, const bool verbose, std::optional<Vertex
 	if (!verifyChainsAndMap(chainsWhite2, chainsBlack2, "2A", cm2, verbose))
 		ok = false;
 
-	std::vector<Vertex> liberties2W, liberties2B;
+	std::vector<point_t> liberties2W, liberties2B;
 	findLiberties(cm2, &liberties2W, B_WHITE);
 	findLiberties(cm2, &liberties2B, B_BLACK);
 
 	printf("white liberties: ");
-	dump(liberties2W);
+	dump(liberties2W, b.getDim());
 	printf("black liberties: ");
-	dump(liberties2B);
+	dump(liberties2B, b.getDim());
 
 	if (liberties2B.empty() == false) {
 		if (move.has_value() == false)
-			move = *liberties2B.begin();
+			move = Vertex(*liberties2B.begin(), b.getDim());
 
-		play(&brd1, move.value(), P_BLACK);
+		play(&brd1, move.value().getV(), P_BLACK);
 
 		ChainMap cm1(brd1.getDim());
 		findChains(brd1, &chainsWhite1, &chainsBlack1, &cm1);
@@ -111,7 +115,14 @@ bool test_connect_play(const Board & b, const bool verbose, std::optional<Vertex
 		if (!verifyChainsAndMap(chainsWhite1, chainsBlack1, "1B", cm1, verbose))
 			ok = false;
 
-		std::vector<Vertex> liberties1W, liberties1B;
+		// the chains kept by the board itself should match a full rescan
+		if (!verifyChainsAndMap(brd1.getChainsWhite(), brd1.getChainsBlack(), "1C", brd1.getChainMap(), verbose))
+			ok = false;
+
+		if (compareChainT(chainsWhite1, brd1.getChainsWhite()) == false || compareChainT(chainsBlack1, brd1.getChainsBlack()) == false)
+			send(verbose, "chains of board mismatch"), ok = false;
+
+		std::vector<point_t> liberties1W, liberties1B;
 		findLiberties(cm1, &liberties1W, B_WHITE);
 		findLiberties(cm1, &liberties1B, B_BLACK);
 
@@ -144,6 +155,36 @@ bool test_connect_play(const Board & b, const bool verbose, std::optional<Vertex
 		if (compareChain(liberties1B, liberties2B) == false)
 			send(verbose, "liberties black mismatch"), ok = false;
 
+		// play + unplay should give the original board (and chains) back
+		{
+			Board brd3(b);
+
+			uint64_t hash_after = brd3.getHashAfter(move.value().getV(), B_BLACK);
+
+			play(&brd3, move.value().getV(), P_BLACK);
+
+			if (brd3.getHash() != hash_after)
+				send(verbose, "getHashAfter mismatch"), ok = false;
+
+			brd3.unplay();
+
+			std::vector<chain_t *> chainsWhite3, chainsBlack3;
+			ChainMap cm3(b.getDim());
+			findChains(b, &chainsWhite3, &chainsBlack3, &cm3);
+
+			if (brd3.getHash() != b.getHash() || brd3.getKey() != b.getKey())
+				send(verbose, "unplay: boards mismatch"), ok = false;
+
+			if (!verifyChainsAndMap(brd3.getChainsWhite(), brd3.getChainsBlack(), "3A", brd3.getChainMap(), verbose))
+				ok = false;
+
+			if (compareChainT(chainsWhite3, brd3.getChainsWhite()) == false || compareChainT(chainsBlack3, brd3.getChainsBlack()) == false)
+				send(verbose, "unplay: chains mismatch"), ok = false;
+
+			purgeChains(&chainsBlack3);
+			purgeChains(&chainsWhite3);
+		}
+
 		if (!ok) {
 			send(true, "# test failed");
 
@@ -171,15 +212,15 @@ bool test_connect_play(const Board & b, const bool verbose, std::optional<Vertex
 
 			send(true, " * liberties black");
 			send(true, "# play(1)");
-			dump(liberties1B);
+			dump(liberties1B, b.getDim());
 			send(true, "# connect(2)");
-			dump(liberties2B);
+			dump(liberties2B, b.getDim());
 
 			send(true, " * liberties white");
 			send(true, "# play(1)");
-			dump(liberties1W);
+			dump(liberties1W, b.getDim());
 			send(true, "# connect(2)");
-			dump(liberties2W);
+			dump(liberties2W, b.getDim());
 
 			send(true, "---");
 		}
@@ -194,7 +235,8 @@ bool test_connect_play(const Board & b, const bool verbose, std::optional<Vertex
 	return ok;
 }
 
-uint64_t perft(const Board & b, std::set<uint64_t> *const seen, const player_t p, const int depth, const int pass, const int verbose, const bool top)
+// "b" is returned in the same state as it was passed
+uint64_t perft(Board *const b, const player_t p, const int depth, const int pass, const int verbose, const bool top)
 {
 	if (depth == 0)
 		return 1;
@@ -202,51 +244,37 @@ uint64_t perft(const Board & b, std::set<uint64_t> *const seen, const player_t p
 	if (pass >= 2)
 		return 0;
 
-	const int      dim        = b.getDim();
-
 	const int      new_depth  = depth - 1;
 	const player_t new_player = getOpponent(p);
 
 	uint64_t       total      = 0;
 
-	// find chains of stones
-	ChainMap cm(dim);
-	std::vector<chain_t *> chainsWhite, chainsBlack;
-	findChains(b, &chainsWhite, &chainsBlack, &cm);
-
-	// find the liberties -> the "moves"
-	std::vector<Vertex> liberties;
-	findLiberties(cm, &liberties, playerToStone(p));
-
-	purgeChains(&chainsBlack);
-	purgeChains(&chainsWhite);
-	
-	for(auto & cross : liberties) {
-		Board new_board(b);
+	move_list_t moves;
+	b->generateMoves(playerToStone(p), &moves);
 
-		play(&new_board, cross, p);
+	const std::string b_str  = verbose == 2 ? dumpToString(*b, p, pass) : "";
+	const uint64_t    b_hash = b->getHash();
 
-		uint64_t hash = new_board.getHash();
+	for(int i=0; i<moves.n; i++) {
+		const point_t cross = moves.moves[i];
 
-		if (seen->find(hash) == seen->end()) {
-			if (verbose == 2)
-				send(true, "%d %s %s %lx", depth, v2t(cross).c_str(), dumpToString(b, p, pass).c_str(), b.getHash());
+		play(b, cross, p);
 
-			seen->insert(hash);
+		if (verbose == 2)
+			send(true, "%d %s %s %lx", depth, v2t({ cross, b->getDim() }).c_str(), b_str.c_str(), b_hash);
 
-			uint64_t cur_count = perft(new_board, seen, new_player, new_depth, 0, verbose, false);
+		uint64_t cur_count = perft(b, new_player, new_depth, 0, verbose, false);
 
-			total += cur_count;
+		total += cur_count;
 
-			if (verbose == 1 && top)
-				send(true, "%s: %ld", v2t(cross).c_str(), cur_count);
+		if (verbose == 1 && top)
+			send(true, "%s: %ld", v2t({ cross, b->getDim() }).c_str(), cur_count);
 
-			seen->erase(hash);
-		}
+		b->unplay();
 	}
 
 	if (pass < 2) {
-		uint64_t cur_count = perft(b, seen, new_player, new_depth, pass + 1, verbose, false);
+		uint64_t cur_count = perft(b, new_player, new_depth, pass + 1, verbose, false);
 
 		total += cur_count;
 
@@ -255,7 +283,7 @@ uint64_t perft(const Board & b, std::set<uint64_t> *const seen, const player_t p
 	}
 
 	if (verbose == 2)
-		send(true, "%d pass %s %lx", depth, dumpToString(b, p, pass).c_str(), b.getHash());
+		send(true, "%d pass %s %lx", depth, dumpToString(*b, p, pass).c_str(), b->getHash());
 
 	if (verbose == 1 && top)
 		send(true, "total: %ld", total);
@@ -272,11 +300,9 @@ void test_perft(const bool verbose, const int dim, const uint64_t *const counts,
 	Board b(&z, dim);
 
 	for(size_t i=0; i<n_counts; i++) {
-		std::set<uint64_t> seen;
-
 		send(verbose, "# testing depth %zu for %d", i + 1, dim);
 
-		uint64_t count = perft(b, &seen, P_BLACK, i + 1, false, verbose, true);
+		uint64_t count = perft(&b, P_BLACK, i + 1, false, verbose, true);
 
 		if (counts[i] != count)
 			send(verbose, "# FAIL depth %zu for %d: expecting %lu, got %lu\n", i + 1, dim, counts[i], count);
@@ -335,7 +361,7 @@ void test(const bool verbose, const bool with_perft)
 			"xxxx...\n"
 			".....xx\n"
 			".....x.\n"
-			, 7, 13.5,
+			, 7, 27.5,
 			{ { "C5", "C6 D5 B5 C4" } },
 			{ { "G2 F2 F1", "G3 F3 E2 G1 E1" }, { "G7 F7 E7 D7 C7 B7 A7 G6 A6 G5 A5 G4 F4 E4 A4 D3 C3 B3 A3", "F6 E6 D6 C6 B6 F5 E5 B5 D4 C4 B4 G3 F3 E3 D2 C2 B2 A2" } }
 			});
@@ -348,7 +374,7 @@ void test(const bool verbose, const bool with_perft)
 			"xxxx...\n"
 			".....xx\n"
 			".o...x.\n"
-			, 7, 13.5,
+			, 7, 27.5,
 			{ { "B1", "B2 C1 A1" } },
 			{ { "G2 F2 F1", "G3 F3 E2 G1 E1" }, { "G7 F7 E7 D7 C7 B7 A7 G6 A6 G5 A5 G4 F4 E4 A4 D3 C3 B3 A3", "F6 E6 D6 C6 B6 F5 E5 B5 D4 C4 B4 G3 F3 E3 D2 C2 B2 A2" } }
 		       	});
@@ -363,7 +389,7 @@ void test(const bool verbose, const bool with_perft)
 			".o...x...\n"
 			"......ooo\n"
 			".....o...\n"
-			, 9, 9.5,
+			, 9, 19.5,
 			{ { "F1", "F2 G1 E1" }, { "J2 H2 G2", "J3 H3 G3 F2 J1 H1 G1" }, { "B3", "B4 C3 A3 B2" }, { "J7", "H7 J6" } },
 			{ { "G4 F4 F3", "G5 F5 H4 E4 G3 E3 F2" }, { "G9 F9 E9 D9 C9 B9 A9 G8 A8 G7 A7 G6 F6 E6 A6 D5 C5 B5 A5", "H9 H8 F8 E8 D8 C8 B8 H7 F7 E7 B7 H6 D6 C6 B6 G5 F5 E5 D4 C4 B4 A4" }, { "J8", "J9 H8" } }
 		       	});
@@ -419,7 +445,7 @@ void test(const bool verbose, const bool with_perft)
 		std::vector<chain_t *> chainsWhite, chainsBlack;
 		findChains(brd, &chainsWhite, &chainsBlack, &cm);
 
-		scanEnclosed(brd, &cm, playerToStone(P_WHITE));
+		findRegions(brd, &cm, playerToStone(P_WHITE));
 
 		if (b.white_chains.size() != chainsWhite.size())
 			send(verbose, "FAIL white: number of chains mismatch"), ok = false;
@@ -497,6 +523,206 @@ void test(const bool verbose, const bool with_perft)
 	if (thirdHash)
 		send(verbose, "FAIL hash (%lx) did not reset", thirdHash);
 
+	// ko & positional superko
+	Board bko(&z, "...../.bw../b.bw./.bw../.....");
+
+	const int     dimko  = bko.getDim();
+	const point_t take   = 2 * dimko + 1;
+	const point_t retake = 2 * dimko + 2;
+	uint64_t      keyko  = bko.getKey();
+
+	bko.play(take, B_WHITE);
+
+	if (bko.getAt(retake) != B_EMPTY)
+		send(verbose, "FAIL ko stone not captured");
+
+	if (bko.getKoPoint() != retake)
+		send(verbose, "FAIL ko point (%d) not detected", bko.getKoPoint());
+
+	if (bko.wouldRepeat(retake, B_BLACK) == false)
+		send(verbose, "FAIL retaking ko not seen as repetition");
+
+	move_list_t movesko;
+	bko.generateMoves(B_BLACK, &movesko);
+
+	if (bko.isLegal(retake, B_BLACK) || std::find(movesko.moves, movesko.moves + movesko.n, retake) != movesko.moves + movesko.n)
+		send(verbose, "FAIL retaking ko generated as a legal move");
+
+	if (movesko.n != dimko * dimko - 8)
+		send(verbose, "FAIL expected %d legal moves, got %d", dimko * dimko - 8, movesko.n);
+
+	if (bko.getKey() == keyko)
+		send(verbose, "FAIL key did not change");
+
+	bko.unplay();
+
+	if (bko.getKoPoint() != -1 || bko.getKey() != keyko)
+		send(verbose, "FAIL ko state not restored by unplay");
+
+	if (bko.wouldRepeat(take, B_WHITE))
+		send(verbose, "FAIL taking ko seen as repetition");
+
+	// Board::assign(): as the copy constructor, in the buffers of an other board
+	Board bassign(&z, dimko);
+	bassign.play(0, B_BLACK);
+
+	bko.play(take, B_WHITE);
+	bassign.assign(bko);
+
+	if (bassign.getKey() != bko.getKey() || bassign.getKoPoint() != retake || bassign.wouldRepeat(retake, B_BLACK) == false || bassign.getChainsWhite().size() != bko.getChainsWhite().size())
+		send(verbose, "FAIL Board::assign did not copy the position");
+
+	bko.unplay();
+
+	uint64_t keyassign = bassign.getKey();
+
+	bassign.play(0, B_BLACK);
+	bassign.unplay();
+
+	if (bassign.getKey() != keyassign || bassign.getAt(0) != B_EMPTY)
+		send(verbose, "FAIL Board::assign: unplay after assign");
+
+	// regions
+	Board breg(&z, "...../.bbb./.b.b./.bbb./.....");
+
+	ChainMap cmreg(breg.getDim());
+	std::vector<chain_t *> chainsWreg, chainsBreg;
+	findChains(breg, &chainsWreg, &chainsBreg, &cmreg);
+
+	findRegions(breg, &cmreg, B_WHITE);
+
+	if (cmreg.getNRegions() != 2)
+		send(verbose, "FAIL expected 2 regions for white, got %d", cmreg.getNRegions());
+
+	if (cmreg.getEnclosed(12) == false || cmreg.getEnclosed(0) || cmreg.getEnclosed(6))
+		send(verbose, "FAIL enclosed crosses mismatch");
+
+	const region_t *eye = cmreg.getRegionAt(12);
+
+	if (eye == nullptr || eye->nEmpty != 1 || eye->borders.size() != 1 || eye->touchesEdge)
+		send(verbose, "FAIL eye region mismatch");
+
+	findRegions(breg, &cmreg, B_BLACK);
+
+	if (cmreg.getNRegions() != 1 || cmreg.getRegion(0).nStones != 8 || cmreg.getRegion(0).nEmpty != 17 || cmreg.getEnclosed(12))
+		send(verbose, "FAIL black region mismatch");
+
+	purgeChains(&chainsWreg);
+	purgeChains(&chainsBreg);
+
+	// parallel alpha-beta: same score as the single threaded search
+	Board bab(&z, "...../.bw../.bw../...../..... b 0");
+
+	Deadline noStop(UINT64_MAX);
+
+	move_list_t movesab;
+	bab.generateMoves(B_BLACK, &movesab);
+
+	int scoreab = search(&bab, P_BLACK, -32767, 32767, 3, 0.5, noStop);
+
+	ThreadPool poolab(3);
+
+	auto resultab = searchParallel(bab, P_BLACK, -32767, 32767, 3, 0.5, movesab, &poolab, nullptr, nullptr, noStop);
+
+	if (resultab.completed == false || resultab.score != scoreab || resultab.move.has_value() == false)
+		send(verbose, "FAIL parallel alpha-beta: %d, expected %d", resultab.score, scoreab);
+
+	// transposition table
+	TranspositionTable ttab(1);
+
+	ttab.store(bab.getKey(), 3, -7, TT_LOWER, 12);
+
+	auto entryab = ttab.lookup(bab.getKey());
+
+	if (entryab.has_value() == false || entryab.value().score != -7 || entryab.value().depth != 3 || entryab.value().bound != TT_LOWER || entryab.value().move != 12)
+		send(verbose, "FAIL transposition table entry mismatch");
+
+	if (ttab.lookup(bab.getKey() ^ 1).has_value())
+		send(verbose, "FAIL transposition table returned an other position");
+
+	ttab.clear();
+
+	ordering_t orderab;
+	orderingClear(&orderab);
+
+	for(int d=1; d<=3; d++) {
+		auto resultTt = searchParallel(bab, P_BLACK, -32767, 32767, d, 0.5, movesab, &poolab, &ttab, &orderab, noStop);
+
+		if (d == 3 && resultTt.score != scoreab)
+			send(verbose, "FAIL alpha-beta with transposition table and move ordering: %d, expected %d", resultTt.score, scoreab);
+	}
+
+	// aspiration windows: a wrong guess costs re-searches, not a wrong score
+	for(int guess : { scoreab, scoreab - 50, scoreab + 50 }) {
+		auto resultAsp = searchAspiration(bab, P_BLACK, 3, guess, 0.5, movesab, &poolab, &ttab, &orderab, noStop);
+
+		if (resultAsp.completed == false || resultAsp.score != scoreab || resultAsp.move.has_value() == false)
+			send(verbose, "FAIL aspiration search with guess %d: %d, expected %d", guess, resultAsp.score, scoreab);
+	}
+
+	// lock-free queue
+	lfqueue<int> q(5);  // rounded up to 8
+
+	int n_put = 0;
+
+	while(q.try_put(n_put))
+		n_put++;
+
+	if (n_put != 8)
+		send(verbose, "FAIL lfqueue holds %d elements, expected 8", n_put);
+
+	for(int i=0; i<n_put; i++) {
+		auto v = q.try_get();
+
+		if (v.has_value() == false || v.value() != i)
+			send(verbose, "FAIL lfqueue order");
+	}
+
+	if (q.try_get().has_value() || q.get(1).has_value() || q.is_empty() == false)
+		send(verbose, "FAIL lfqueue not empty");
+
+	q.put(1);
+	q.interrupt();
+
+	if (q.get().has_value())
+		send(verbose, "FAIL lfqueue not interrupted");
+
+	// time manager
+	TimeManager tm(0.5);
+	Board btm(&z, 9);
+
+	tm.setSettings(TC_CANADIAN, 10., 30., 5);
+
+	time_budget_t tmMain = tm.allocate(P_BLACK, btm, 81);
+
+	if (tmMain.target <= 0. || tmMain.limit < tmMain.target || tmMain.limit > 10.)
+		send(verbose, "FAIL time allocated in main time: %f/%f", tmMain.target, tmMain.limit);
+
+	tm.moveDone(P_BLACK, 11.);  // main time used up: byo-yomi
+
+	if (std::abs(tm.allocate(P_BLACK, btm, 81).target - (30. - 0.5) / 5) > 0.001)
+		send(verbose, "FAIL time allocated in byo-yomi: %f", tm.allocate(P_BLACK, btm, 81).target);
+
+	tm.setTimeLeft(P_WHITE, 4.5, 2);
+
+	if (std::abs(tm.allocate(P_WHITE, btm, 81).target - 2.) > 0.001 || tm.allocate(P_WHITE, btm, 81).limit > 4.)
+		send(verbose, "FAIL time allocated after time_left: %f", tm.allocate(P_WHITE, btm, 81).target);
+
+	tm.setSettings(TC_ABSOLUTE, 600., 0., 0);
+	tm.setTimeLeft(P_WHITE, 0.2, 0);  // less than the margin
+
+	time_budget_t tmLow = tm.allocate(P_WHITE, btm, 81);
+
+	if (tmLow.target <= 0. || tmLow.limit < tmLow.target)
+		send(verbose, "FAIL no time allocated for a clock below the margin: %f/%f", tmLow.target, tmLow.limit);
+
+	tm.setSettings(TC_JAPANESE, 0., 5., 3);
+
+	tm.moveDone(P_BLACK, 6.);  // period lost
+
+	if (tm.toString(P_BLACK).find("left: 5.0s/2") == std::string::npos)
+		send(verbose, "FAIL japanese byo-yomi period not lost: %s", tm.toString(P_BLACK).c_str());
+
 	// "connect()"
 	for(auto b : boards)
 		test_connect_play(stringToBoard(b.b), verbose, { });
@@ -13,15 +13,6 @@ Vertex::Vertex(const int x, const int y, const int dim) : v(y * dim + x), dim(di
        assert(dim & 1);
 }
 
-Vertex::Vertex(const Vertex & v) : v(v.getV()), dim(v.getDim())
-{
-       assert(dim & 1);
-}
-
-Vertex::~Vertex()
-{
-}
-
 bool Vertex::operator<(const Vertex & rhs) const
 {
        return v < rhs.v;
@@ -1,8 +1,15 @@
 #pragma once
 
 #include <functional>
+#include <stdint.h>
 
 
+constexpr int MAX_DIM = 25;  // largest board supported
+
+// a cross as y * dim + x; the board it is on knows dim
+// used internally (move lists, chains), Vertex is for the GTP/text side
+typedef uint16_t point_t;
+
 class Vertex
 {
 private:
@@ -12,8 +19,6 @@ private:
 public:
 	Vertex(const int v, const int dim);
 	Vertex(const int x, const int y, const int dim);
-	Vertex(const Vertex & v);
-	virtual ~Vertex();
 
 	bool operator<(const Vertex & rhs) const;
 	bool operator==(const Vertex & rhs) const;
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <assert.h>
+#include <bit>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vertex.h"
+
+
+constexpr int VERTEXSET_WORDS = (MAX_DIM * MAX_DIM + 63) / 64;
+
+// a set of crosses (e.g. the liberties of a chain) as one bit per cross
+// bit "v" is the point_t, the number of elements is kept so that size() is O(1)
+class VertexSet
+{
+private:
+	uint64_t w[VERTEXSET_WORDS] { 0 };
+	int      dim                { 0 };
+	int      n                  { 0 };
+
+public:
+	VertexSet()
+	{
+	}
+
+	VertexSet(const int dim) : dim(dim)
+	{
+	}
+
+	class iterator
+	{
+	private:
+		const VertexSet *s    { nullptr };
+		int              i    { 0       };
+		uint64_t         word { 0       };
+
+		void skip()
+		{
+			while(word == 0 && ++i < VERTEXSET_WORDS)
+				word = s->w[i];
+		}
+
+	public:
+		iterator(const VertexSet *const s, const int i) : s(s), i(i)
+		{
+			if (i < VERTEXSET_WORDS) {
+				word = s->w[i];
+				skip();
+			}
+		}
+
+		point_t operator*() const
+		{
+			return i * 64 + std::countr_zero(word);
+		}
+
+		iterator & operator++()
+		{
+			word &= word - 1;
+			skip();
+
+			return *this;
+		}
+
+		bool operator==(const iterator & rhs) const
+		{
+			return i == rhs.i && word == rhs.word;
+		}
+
+		bool operator!=(const iterator & rhs) const
+		{
+			return !(*this == rhs);
+		}
+	};
+
+	iterator begin() const
+	{
+		return { this, 0 };
+	}
+
+	iterator end() const
+	{
+		return { this, VERTEXSET_WORDS };
+	}
+
+	int getDim() const
+	{
+		return dim;
+	}
+
+	void setDim(const int dim)
+	{
+		this->dim = dim;
+	}
+
+	size_t size() const
+	{
+		return n;
+	}
+
+	bool empty() const
+	{
+		return n == 0;
+	}
+
+	bool contains(const int v) const
+	{
+		return (w[v >> 6] >> (v & 63)) & 1;
+	}
+
+	void insert(const int v)
+	{
+		assert(v >= 0 && v < MAX_DIM * MAX_DIM);
+
+		const uint64_t mask = uint64_t(1) << (v & 63);
+
+		n += (w[v >> 6] & mask) == 0;
+
+		w[v >> 6] |= mask;
+	}
+
+	void erase(const int v)
+	{
+		const uint64_t mask = uint64_t(1) << (v & 63);
+
+		n -= (w[v >> 6] & mask) != 0;
+
+		w[v >> 6] &= ~mask;
+	}
+
+	void clear()
+	{
+		for(int i=0; i<VERTEXSET_WORDS; i++)
+			w[i] = 0;
+
+		n = 0;
+	}
+
+	// add all crosses of "other"; "other" is left as is
+	void merge(const VertexSet & other)
+	{
+		if (dim == 0)
+			dim = other.dim;
+
+		n = 0;
+
+		for(int i=0; i<VERTEXSET_WORDS; i++) {
+			w[i] |= other.w[i];
+
+			n += std::popcount(w[i]);
+		}
+	}
+
+	bool operator==(const VertexSet & rhs) const
+	{
+		if (n != rhs.n)
+			return false;
+
+		for(int i=0; i<VERTEXSET_WORDS; i++) {
+			if (w[i] != rhs.w[i])
+				return false;
+		}
+
+		return true;
+	}
+};
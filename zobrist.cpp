@@ -5,6 +5,12 @@
 Zobrist::Zobrist(const int dim)
 {
 	setDim(dim);
+
+	rngSide      = distribution(gen);
+
+	// 0 passes leaves the hash as is
+	rngPasses[1] = distribution(gen);
+	rngPasses[2] = distribution(gen);
 }
 
 Zobrist::~Zobrist()
@@ -17,9 +23,27 @@ void Zobrist::setDim(const int dim)
 
 	for(size_t i=rngs.size(); i<newN; i++)
 		rngs.push_back(distribution(gen));
+
+	for(size_t i=rngsKo.size(); i<size_t(dim * dim); i++)
+		rngsKo.push_back(distribution(gen));
 }
 
 uint64_t Zobrist::get(const int nr, const bool black) const
 {
 	return rngs.at(nr * 2 + black);
 }
+
+uint64_t Zobrist::getSide() const
+{
+	return rngSide;
+}
+
+uint64_t Zobrist::getKo(const int nr) const
+{
+	return rngsKo.at(nr);
+}
+
+uint64_t Zobrist::getPasses(const int n) const
+{
+	return rngPasses[n > 2 ? 2 : n];
+}
@@ -8,6 +8,9 @@
 class Zobrist {
 private:
 	std::vector<std::uint64_t> rngs;
+	std::vector<std::uint64_t> rngsKo;
+	std::uint64_t              rngSide      { 0 };
+	std::uint64_t              rngPasses[3] { 0 };
 
 	std::uniform_int_distribution<std::uint64_t> distribution{ std::numeric_limits<std::uint64_t>::min(), std::numeric_limits<std::uint64_t>::max() };
 
@@ -18,4 +21,8 @@ public:
 	void setDim(const int dim);
 
 	uint64_t get(const int nr, const bool black) const;
+	// for the state next to the stones: white to move, the simple ko point and the number (0...2) of consecutive passes
+	uint64_t getSide() const;
+	uint64_t getKo(const int nr) const;
+	uint64_t getPasses(const int n) const;
 };